@@ -0,0 +1,56 @@
+#pragma once
+
+#include "util/array_utils.hpp"
+
+#include <libsnark/gadgetlib1/pb_variable.hpp>
+
+// Size of a circuit as it stands on a protoboard
+struct GadgetCost
+{
+    size_t constraints;
+    size_t variables;
+    size_t nonzero_terms;
+
+    bool operator==(const GadgetCost &o) const
+    {
+        return constraints == o.constraints && variables == o.variables &&
+               nonzero_terms == o.nonzero_terms;
+    }
+};
+
+// Nonzero a, b and c terms of every constraint on the protoboard
+template<typename Field>
+size_t count_nonzero_terms(const libsnark::protoboard<Field> &pb)
+{
+    size_t terms = 0;
+
+    for (auto &&c : pb.get_constraint_system().constraints)
+        terms += c.a.terms.size() + c.b.terms.size() + c.c.terms.size();
+
+    return terms;
+}
+
+// Cost of one hash gadget built on a scratch protoboard with set_max_terms(max_terms). The static
+// cost functions of the gadgets describe the unbounded circuit (max_terms = 0); bound() replaces
+// long LCs by fresh variables, which changes all three counts in a way only the build tells.
+template<typename GadHash>
+GadgetCost measure_gadget_cost(size_t max_terms = 0)
+{
+    using Field = typename GadHash::Field;
+    using DigVar = typename GadHash::DigVar;
+    using BlockVar = typename GadHash::BlockVar;
+
+    static constexpr size_t DIGEST_VARS = GadHash::DIGEST_VARS;
+
+    libsnark::protoboard<Field> pb;
+    DigVar out{pb, DIGEST_VARS, FMT("out")};
+    BlockVar in{make_uniform_array<BlockVar>(pb, DIGEST_VARS, FMT("in"))};
+    size_t vars = pb.num_variables();
+
+    GadHash gadget{pb, in, out, ""};
+
+    gadget.set_max_terms(max_terms);
+    gadget.generate_r1cs_constraints();
+
+    return {pb.num_constraints(), pb.num_variables() - vars, count_nonzero_terms(pb)};
+}
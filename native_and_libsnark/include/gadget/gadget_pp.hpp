@@ -2,6 +2,9 @@
 
 #include <libsnark/gadgetlib1/gadgets/basic_gadgets.hpp>
 
+#include <algorithm>
+#include <iterator>
+
 template<typename FieldT>
 class GadgetPP : public libsnark::gadget<FieldT>
 {
@@ -10,9 +13,73 @@ public:
 
     using super::super;
 
+    // Linear combinations longer than this are materialized by bound() (0: never, the default).
+    // The static cost functions of the gadgets assume 0, measure_gadget_cost() (in
+    // gadget/gadget_cost.hpp) reports the cost of a bounded circuit.
+    void set_max_terms(size_t n) { max_terms = n; }
+
 protected:
     using LC = libsnark::linear_combination<FieldT>;
 
+    size_t max_terms = 0;
+    std::vector<std::pair<libsnark::pb_variable<FieldT>, LC>> bounded;
+
+    // Replace x with a fresh variable (and one constraint) if it has more than max_terms terms.
+    // Worth it for LCs which are read more than once or carried into the next round.
+    inline size_t bound(LC &x)
+    {
+        if (!max_terms || x.terms.size() <= max_terms)
+            return 0;
+
+        libsnark::pb_variable<FieldT> v;
+
+        v.allocate(this->pb, FMT(this->annotation_prefix, "_bound_%llu", bounded.size()));
+        constrain(x, 1, v);
+        bounded.emplace_back(v, x);
+        x = v;
+
+        return 1;
+    }
+
+    // Write n values to a block of variables at once. Variables allocated one after the other
+    // occupy consecutive slots of the protoboard assignment, so the block is a single copy.
+    template<typename Vars>
+    void assign(const Vars &vars, const FieldT *values)
+    {
+        size_t n = std::size(vars);
+
+        if (!n)
+            return;
+
+        const auto &first = *std::begin(vars);
+        // every index must follow the previous one: the ends alone do not tell a gap from a
+        // variable out of order
+        bool contiguous = first.index &&
+                          std::adjacent_find(std::begin(vars), std::end(vars),
+                                             [](const auto &a, const auto &b)
+                                             { return b.index != a.index + 1; }) == std::end(vars);
+
+        if (contiguous)
+            std::copy_n(values, n, &this->pb.val(first));
+        else
+            for (auto &&x : vars)
+                this->pb.val(x) = *values++;
+    }
+
+    // Values of the variables created by bound(), once the rest of the witness is known
+    void generate_bounded_witness()
+    {
+        for (auto &&[v, x] : bounded)
+        {
+            FieldT sum = 0;
+
+            for (auto &&t : x.terms)
+                sum += t.coeff * this->pb.val(libsnark::pb_variable<FieldT>(t.index));
+
+            this->pb.val(v) = sum;
+        }
+    }
+
     inline size_t constrain(const LC &x, const LC &y, const LC &z)
     {
         this->pb.add_r1cs_constraint(libsnark::r1cs_constraint<FieldT>(x, y, z), FMT(""));
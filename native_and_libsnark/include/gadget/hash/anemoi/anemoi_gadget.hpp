@@ -28,6 +28,7 @@ private:
     using super = GadgetPP<typename Anemoi::Field>;
     using LC = typename super::LC;
 
+    using super::assign;
     using super::constrain;
     using super::val;
 
@@ -36,13 +37,26 @@ private:
     static constexpr auto &alpha = Hash::alpha;
     static constexpr auto &g = Hash::g;
     static constexpr auto &g_i = Hash::g_i;
-    static constexpr auto &mat = Hash::mat;
     static constexpr auto &rc = Hash::round_c;
 
     std::vector<PbVariablePP<Field>> inter[ELL];
 
+    // Terms of one round, given the size of the union of all the branches (w)
+    static constexpr size_t round_terms(size_t w) { return ELL * (6 * w + 14); }
+
 public:
-    static size_t size() { return ELL * INTER_N; }
+    static constexpr size_t size() { return ELL * INTER_N; }
+
+    // CIRCUIT COST (what generate_r1cs_constraints() produces, without a protoboard)
+    static constexpr size_t variables() { return size(); }
+
+    static constexpr size_t constraints() { return variables() + 1; }
+
+    static constexpr size_t nonzero_terms()
+    {
+        // the first round mixes the inputs, every other one the previous round's outputs
+        return round_terms(RATE + 1) + (ROUNDS_N - 1) * round_terms(2 * ELL + 1) + ELL + 3;
+    }
 
 
     AnemoiGadget(libsnark::protoboard<Field> &pb, const BlockVar &in, const DigVar &out,
@@ -56,6 +70,8 @@ public:
 
     void generate_r1cs_constraints()
     {
+        // the linear layer of the native permutation, whose trace is the witness
+        const auto &mat = Hash::layer_matrix();
         size_t i[ELL]{};
         LC tx[ELL]{};
         LC ty[ELL]{};
@@ -159,106 +175,21 @@ public:
 
     void generate_r1cs_witness()
     {
-        std::array<size_t, ELL> i{};
-        std::array<Field, ELL> tx{};
-        std::array<Field, ELL> ty{};
-        std::array<Field, ELL> sx{};
-        std::array<Field, ELL> sy{};
-
-        for (size_t j = 0; j < std::min(RATE, ELL); ++j)
-            tx[j] = val(in[j][0]);
-
-        for (size_t j = ELL; j < RATE; ++j)
-            ty[j - ELL] = val(in[j][0]);
-
-        for (size_t j = 0; j < ROUNDS_N; ++j)
-        {
-            // ADD CONSTANTS
-            for (size_t k = 0; k < ELL; ++k)
-            {
-                tx[k] = tx[k] + rc[j * ELL + k].first;
-                ty[k] = ty[k] + rc[j * ELL + k].second;
-            }
-
-            // M_x MULTIPLICATION
-            for (size_t k = 0; k < ELL; ++k)
-                for (size_t l = 0; l < ELL; ++l)
-                    sx[k] = sx[k] + mat[k * ELL + l] * tx[l];
-
-            // Rho ROTATION
-            std::rotate(ty.begin(), ty.begin() + 1, ty.end());
-
-            // M_y MULTIPLICATION
-            for (size_t k = 0; k < ELL; ++k)
-                for (size_t l = 0; l < ELL; ++l)
-                    sy[k] = sy[k] + mat[k * ELL + l] * ty[l];
-
-            // PSEUDO-HADAMARD
-            for (size_t k = 0; k < ELL; ++k)
-            {
-                tx[k] = sx[k] + sy[k];
-                ty[k] = sy[k] + tx[k];
-            }
-
-            // Flystel SBOX
-            /*
-            Flystel performs the following computations:
-                1. x_1 = x_0 - (g(y_0 * y_0) + g_i)
-                2. y_1 = y_0 - x_1^(a_i)
-                3. x_2 = x_1 + g(y_1 * y_1)
-            */
-            for (size_t k = 0; k < ELL; ++k)
-            {
-                /*
-                1.  x_1 = x_0 - (g * y_0 * y_0 + g_i)    <==>
-                    x_1 - x_0 + g_i = -gy_0 * y_0
-                */
-                val(inter[k][i[k]]) = tx[k] - (g * ty[k] * ty[k] + g_i);
-                ++i[k];
+        typename Hash::Sponge h{};
+        typename Hash::Trace trace;
 
-                // 2. y_1 = y_0 - x_1^(a_i)    <==>    (y_0 - y_1)^a = x_1
-                // t = x_1^a
-                tx[k] = val(inter[k][i[k] - 1]);
-                Hash::raise_alpha_inv(tx[k]);
-                val(inter[k][i[k]]) = ty[k] - tx[k];
-                ++i[k];
-
-                // t^2
-                val(inter[k][i[k]]) = tx[k] * tx[k];
-                ++i[k];
-                // t^4
-                val(inter[k][i[k]]) = val(inter[k][i[k] - 1]) * val(inter[k][i[k] - 1]);
-                ++i[k];
-
-                // 3. x_2 = x_1 + g(y_1 * y_1)
-                val(inter[k][i[k]]) = val(inter[k][i[k] - 4]) +
-                                      g * val(inter[k][i[k] - 3]) * val(inter[k][i[k] - 3]);
-                ++i[k];
-            }
-            // update temporaries
-            for (size_t k = 0; k < ELL; ++k)
-            {
-                tx[k] = val(inter[k][i[k] - 1]);
-                ty[k] = val(inter[k][i[k] - 4]);
-                sx[k] = 0;
-                sy[k] = 0;
-            }
-        }
-
-        // FINAL M_x MULTIPLICATION
         for (size_t k = 0; k < ELL; ++k)
-            for (size_t l = 0; l < ELL; ++l)
-                sx[k] = sx[k] + mat[k * ELL + l] * tx[l];
+            trace.resize(k, inter[k].size());
 
-        // FINAL Rho ROTATION
-        std::rotate(ty.begin(), ty.begin() + 1, ty.end());
+        for (size_t j = 0; j < RATE; ++j)
+            h[j] = val(in[j][0]);
+
+        // The native permutation records the S-box intermediates in the order of inter
+        Hash::hash_field(h, &trace);
 
-        // FINAL M_y MULTIPLICATION
         for (size_t k = 0; k < ELL; ++k)
-            for (size_t l = 0; l < ELL; ++l)
-                sy[k] = sy[k] + mat[k * ELL + l] * ty[l];
+            assign(inter[k], trace.data(k));
 
-        // bind output
-        val(out[0]) = sx[0];
+        val(out[0]) = h[0];
     }
 };
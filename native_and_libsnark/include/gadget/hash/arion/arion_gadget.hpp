@@ -27,20 +27,43 @@ private:
     using super = GadgetPP<typename Arion::Field>;
     using LC = typename super::LC;
 
+    using super::assign;
+    using super::bound;
     using super::constrain;
+    using super::generate_bounded_witness;
     using super::val;
 
     static constexpr size_t N = BRANCH_N - 1;
 
-    static constexpr size_t D2_CONSTR = std::__bit_width(Hash::D2); // assuming D2 = 2^k + 1
+    static constexpr size_t D2_CONSTR = Hash::D2_BITS;
     static constexpr size_t D2_CONSTR1 = D2_CONSTR - 1;
     static constexpr size_t INTERn_N = D2_CONSTR * ROUNDS_N;
     static constexpr size_t INTERk_N = 5 * ROUNDS_N;
 
     std::array<std::vector<PbVariablePP<Field>>, BRANCH_N> inter;
 
+    // Terms of one round, given the size of each branch (t), of their union (u) and whether the
+    // branches lack the constant term (nc)
+    static constexpr size_t round_terms(size_t t, size_t u, size_t nc)
+    {
+        return 2 + t + 3 * D2_CONSTR1 + N * (3 * t + 4 * u + 11 + nc) + 2 * N * (N + 1);
+    }
+
 public:
-    static size_t size() { return INTERn_N + INTERk_N * (BRANCH_N - 1); }
+    static constexpr size_t size() { return INTERn_N + INTERk_N * (BRANCH_N - 1); }
+
+    // CIRCUIT COST (what generate_r1cs_constraints() produces, without a protoboard, for the
+    // default max_terms = 0; measure_gadget_cost() reports a bounded circuit)
+    static constexpr size_t variables() { return size(); }
+
+    static constexpr size_t constraints() { return variables() + 1; }
+
+    static constexpr size_t nonzero_terms()
+    {
+        // the first round sees the bare inputs, every other one the previous round and constants
+        return round_terms(RATE, RATE, 1) +
+               (ROUNDS_N - 1) * round_terms(BRANCH_N + 1, BRANCH_N + 1, 0) + BRANCH_N + 3;
+    }
 
     ArionGadget(libsnark::protoboard<Field> &pb, const BlockVar &in, const DigVar &out,
                 const std::string &ap) :
@@ -84,6 +107,9 @@ public:
 
         for (size_t j = 0; j < ROUNDS_N; ++j)
         {
+            for (size_t k = 0; k < BRANCH_N; ++k)
+                bound(t[k]);
+
             // GTDS
             // y = x^(1/4097) <==> y^4097 = x
             // y^4096 * y = x
@@ -93,6 +119,8 @@ public:
                 i[N] += constrain(inter[N][i[N]], inter[N][i[N]], inter[N][i[N] - 1]);
 
             // x^d * g(x) + h(x)
+            LC suffix;
+
             for (size_t k = BRANCH_N - 2; k != (size_t)~0; --k)
             {
                 // x^5
@@ -100,11 +128,11 @@ public:
                 i[k] += constrain(inter[k][i[k] - 1], inter[k][i[k] - 1], inter[k][i[k]]);
                 i[k] += constrain(inter[k][i[k] - 1], t[k], inter[k][i[k]]);
 
-                // sigma = sum_{l=k+1}^{BRANCH_N}{x[l] + f[l]}
-                sigma = t[k + 1] + inter[k + 1][i[k + 1] - 1];
-                for (size_t l = k + 2; l < BRANCH_N; ++l)
-                    sigma = sigma + t[l] + inter[l][i[l] - 1];
-
+                // sigma = sum_{l=k+1}^{BRANCH_N}{x[l] + f[l]}, the running suffix sum of branch
+                // k + 1 and one more pair (once bounded, the next branches build on the variable)
+                suffix = suffix + t[k + 1] + inter[k + 1][i[k + 1] - 1];
+                bound(suffix);
+                sigma = suffix;
                 i[k] += constrain(sigma, sigma, inter[k][i[k]]);
 
                 // g(x) = s^2 + a1*s + a2
@@ -141,93 +169,23 @@ public:
 
     void generate_r1cs_witness()
     {
-        std::array<size_t, BRANCH_N> i{};
-        std::array<Field, BRANCH_N> t{};
-        Field sigma;
-        Field g;
-
-        for (size_t i = 0; i < RATE; ++i)
-            t[i] = val(in[i][0]);
-
-        // FIRST CIRCULANT MATRIX
-        sigma = t[0];
-        g = t[0];
-        for (size_t i = 1; i < BRANCH_N; ++i)
-            sigma += t[i];
-
-        t[0] = sigma;
-        for (size_t i = 1; i < BRANCH_N; ++i)
-            t[0] += Hash::circ_mat[i - 1] * t[i];
-
-        for (size_t i = 1; i < BRANCH_N; ++i)
-        {
-            std::swap(t[i], g);
-            t[i] *= Hash::circ_mat[BRANCH_N - 1];
-            t[i] += t[i - 1];
-            t[i] -= sigma;
-        }
+        typename Hash::Sponge h{};
+        typename Hash::Trace trace;
 
-        for (size_t j = 0; j < ROUNDS_N; ++j)
-        {
-            // GTDS
-            // y = x^(1/4097)
-            val(inter[N][i[N] + D2_CONSTR1]) = t[N];
-            Hash::pow_e(val(inter[N][i[N] + D2_CONSTR1]));
-            for (size_t k = 0; k < D2_CONSTR1; ++k)
-            {
-                val(inter[N][i[N] + (D2_CONSTR1 - k - 1)]) =
-                    val(inter[N][i[N] + (D2_CONSTR1 - k)]) * val(inter[N][i[N] + (D2_CONSTR1 - k)]);
-            }
-            i[N] += D2_CONSTR;
-
-            // x^d * g(x) + h(x)
-            for (size_t k = BRANCH_N - 2; k != (size_t)~0; --k)
-            {
-                // x^5
-                val(inter[k][i[k]]) = t[k] * t[k];
-                ++i[k];
-                val(inter[k][i[k]]) = val(inter[k][i[k] - 1]) * val(inter[k][i[k] - 1]);
-                ++i[k];
-                val(inter[k][i[k]]) = val(inter[k][i[k] - 1]) * t[k];
-                ++i[k];
-
-                // sigma = sum_{l=k+1}^{BRANCH_N}{x[l] + f[l]}
-                sigma = t[k + 1] + val(inter[k + 1][i[k + 1] - 1]);
-                for (size_t l = k + 2; l < BRANCH_N; ++l)
-                    sigma += t[l] + val(inter[l][i[l] - 1]);
-
-                val(inter[k][i[k]]) = sigma * sigma;
-                ++i[k];
-                // g(x) = s^2 + a1*s + a2
-                g = val(inter[k][i[k] - 1]) + Hash::alpha.first * sigma + Hash::alpha.second;
-                // h(x) = s^2 + b*s
-                sigma = val(inter[k][i[k] - 1]) + Hash::beta1 * sigma;
-                // y = x^d * g(x) + h(x)
-                val(inter[k][i[k]]) = val(inter[k][i[k] - 2]) * g + sigma;
-                ++i[k];
-            }
-            // CIRCULANT MATRIX
-            sigma = val(inter[0][i[0] - 1]);
-            for (size_t k = 1; k < BRANCH_N; ++k)
-                sigma += val(inter[k][i[k] - 1]);
+        for (size_t k = 0; k < BRANCH_N; ++k)
+            trace.resize(k, inter[k].size());
 
-            t[0] = sigma;
-            for (size_t k = 1; k < BRANCH_N; ++k)
-                t[0] += Hash::circ_mat[k - 1] * val(inter[k][i[k] - 1]);
+        for (size_t j = 0; j < RATE; ++j)
+            h[j] = val(in[j][0]);
 
-            for (size_t k = 1; k < BRANCH_N; ++k)
-            {
-                t[k] = Hash::circ_mat[BRANCH_N - 1] * val(inter[k - 1][i[k - 1] - 1]);
-                t[k] += t[k - 1];
-                t[k] -= sigma;
-            }
+        // The native permutation records the S-box intermediates in the order of inter
+        Hash::hash_field(h, &trace);
 
-            // ADD CONSTANTS
-            for (size_t k = 0; k < BRANCH_N; ++k)
-                t[k] += Hash::round_c[j * BRANCH_N + k];
-        }
+        for (size_t k = 0; k < BRANCH_N; ++k)
+            assign(inter[k], trace.data(k));
 
-        val(out[0]) = t[0];
+        val(out[0]) = h[0];
+        generate_bounded_witness();
     }
 };
 
@@ -27,7 +27,10 @@ private:
     using super = GadgetPP<typename Griffin::Field>;
     using LC = typename super::LC;
 
+    using super::assign;
+    using super::bound;
     using super::constrain;
+    using super::generate_bounded_witness;
     using super::val;
 
     static constexpr size_t INTER0_N = 3 * ROUNDS_N;
@@ -42,8 +45,28 @@ private:
 
     std::vector<PbVariablePP<Field>> inter[BRANCH_N];
 
+    // Terms of one round, given the size of each branch (t), the size of the Lagrange input of
+    // branches 3.. (l) and whether it lacks the constant term (nc)
+    static constexpr size_t round_terms(size_t t, size_t l, size_t nc)
+    {
+        return (t + 8) + (3 * t + 6) + (t + 10) + (BRANCH_N - 3) * (3 * l + 3 + nc + t);
+    }
+
 public:
-    static size_t size() { return INTER0_N + INTER1_N + (BRANCH_N - 2) * INTERk_N; }
+    static constexpr size_t size() { return INTER0_N + INTER1_N + (BRANCH_N - 2) * INTERk_N; }
+
+    // CIRCUIT COST (what generate_r1cs_constraints() produces, without a protoboard, for the
+    // default max_terms = 0; measure_gadget_cost() reports a bounded circuit)
+    static constexpr size_t variables() { return size(); }
+
+    static constexpr size_t constraints() { return variables() + 1; }
+
+    static constexpr size_t nonzero_terms()
+    {
+        // the first round sees the bare inputs, every other one the previous round and constants
+        return round_terms(RATE, RATE + 2, 1) +
+               (ROUNDS_N - 1) * round_terms(BRANCH_N + 1, BRANCH_N + 3, 0) + BRANCH_N + 3;
+    }
 
     GriffinGadget(libsnark::protoboard<Field> &pb, const BlockVar &in, const DigVar &out,
                   const std::string &annotation_prefix) :
@@ -90,6 +113,9 @@ public:
 
         for (size_t j = 0; j < ROUNDS_N; ++j)
         {
+            for (size_t k = 0; k < BRANCH_N; ++k)
+                bound(t[k]);
+
             // Base case, y[0] = x[0]^e = x[0]^(1/d) (d = 5)
             i[0] += constrain(inter[0][i[0]], inter[0][i[0] + 2], t[0]);
             i[0] += constrain(inter[0][i[0]], inter[0][i[0]], inter[0][i[0] - 1]);
@@ -108,6 +134,7 @@ public:
                 l = gamma * inter[0][i[0] - 1] + inter[1][i[1] - 1];
                 if (k != 2)
                     l = l + t[k - 1];
+                bound(l);
                 // y = x*(l^2 + a*l + b) <==> y' - (a*l + b) = l^2 && y = x*y'
                 i[k] += constrain(l, l, inter[k][i[k]] - (alpha.first * l + alpha.second));
                 i[k] += constrain(t[k], inter[k][i[k] - 1], inter[k][i[k]]);
@@ -144,97 +171,22 @@ public:
 
     void generate_r1cs_witness()
     {
-        size_t i[BRANCH_N]{};
-        Field s[BRANCH_N]{};
-        Field t[BRANCH_N]{};
-        Field l;
+        typename Hash::Sponge h{};
+        typename Hash::Trace trace;
 
-        for (size_t j = 0; j < RATE; ++j)
-            s[j] = val(in[j][0]);
-
-        // first circulant matrix
-        if constexpr (BRANCH_N <= 4)
-        {
-            for (size_t j = 0; j < BRANCH_N; ++j)
-                for (size_t k = 0; k < BRANCH_N; ++k)
-                    t[j] = t[j] + circ_mat[(BRANCH_N - j + k) % BRANCH_N] * s[k];
-        }
-        else
-        {
-            static_assert(BRANCH_N % 4 == 0, "BRANCH_N must be a multiple of 4");
-
-            for (size_t j = 0; j < BRANCH_N4; ++j)
-                for (size_t k1 = 0; k1 < BRANCH_N4; ++k1)
-                    for (size_t k2 = 0, off = 4 * (j != k1); k2 < 4; ++k2)
-                        for (size_t k3 = 0; k3 < 4; ++k3)
-                            t[4 * j + k2] += circ_mat[off + k3] * s[4 * k1 + k3];
-        }
+        for (size_t k = 0; k < BRANCH_N; ++k)
+            trace.resize(k, inter[k].size());
 
-        for (size_t j = 0; j < ROUNDS_N; ++j)
-        {
-            // GTDS
-            // y = x^(1/5)
-            val(inter[0][i[0] + 2]) = t[0];
-            Hash::fifth_inv(val(inter[0][i[0] + 2]));
-            val(inter[0][i[0] + 1]) = val(inter[0][i[0] + 2]) * val(inter[0][i[0] + 2]);
-            val(inter[0][i[0]]) = val(inter[0][i[0] + 1]) * val(inter[0][i[0] + 1]);
-            i[0] += 3;
-
-            // x^5
-            val(inter[1][i[1]]) = t[1] * t[1];
-            ++i[1];
-            val(inter[1][i[1]]) = val(inter[1][i[1] - 1]) * val(inter[1][i[1] - 1]);
-            ++i[1];
-            val(inter[1][i[1]]) = val(inter[1][i[1] - 1]) * t[1];
-            ++i[1];
-
-            // L(x1, x2, 0) = gamma*x1 + x2
-            l = gamma * val(inter[0][i[0] - 1]) + val(inter[1][i[1] - 1]);
-
-            // Recursive case y[i] = x[i] * (L(y0,y1,old)^2 + a1*L(y0,y1,old) + a2)
-            for (size_t k = 2; k < BRANCH_N; ++k)
-            {
-                l = gamma;
-                l *= val(inter[0][i[0] - 1]);
-                l += val(inter[1][i[1] - 1]);
-                if (k != 2)
-                    l += t[k - 1];
-                val(inter[k][i[k]]) = l;
-                val(inter[k][i[k]]) += alpha.first;
-                val(inter[k][i[k]]) *= l;
-                val(inter[k][i[k]]) += alpha.second;
-                ++i[k];
-                val(inter[k][i[k]]) = val(inter[k][i[k] - 1]);
-                val(inter[k][i[k]]) *= t[k];
-                ++i[k];
-            }
-
-            for (size_t k = 0; k < BRANCH_N; ++k)
-                t[k] = 0;
+        for (size_t j = 0; j < RATE; ++j)
+            h[j] = val(in[j][0]);
 
-            // CIRCULANT MATRIX
-            if constexpr (BRANCH_N <= 4)
-            {
-                for (size_t k1 = 0; k1 < BRANCH_N; ++k1)
-                    for (size_t k2 = 0; k2 < BRANCH_N; ++k2)
-                        t[k1] += circ_mat[(BRANCH_N - k1 + k2) % BRANCH_N] *
-                                 val(inter[k2][i[k2] - 1]);
-            }
-            else
-            {
-                for (size_t k1 = 0; k1 < BRANCH_N4; ++k1)
-                    for (size_t k2 = 0; k2 < BRANCH_N4; ++k2)
-                        for (size_t k3 = 0, off = 4 * (k1 != k2); k3 < 4; ++k3)
-                            for (size_t k4 = 0; k4 < 4; ++k4)
-                                t[4 * k1 + k3] += circ_mat[off + k4] *
-                                                  val(inter[4 * k2 + k4][i[4 * k2 + k4] - 1]);
-            }
+        // The native permutation records the S-box intermediates in the order of inter
+        Hash::hash_field(h, &trace);
 
-            // ADD CONSTANTS
-            for (size_t k = 0; k < BRANCH_N; ++k)
-                t[k] += rc[j * BRANCH_N + k];
-        }
+        for (size_t k = 0; k < BRANCH_N; ++k)
+            assign(inter[k], trace.data(k));
 
-        val(out[0]) = t[0];
+        val(out[0]) = h[0];
+        generate_bounded_witness();
     }
 };
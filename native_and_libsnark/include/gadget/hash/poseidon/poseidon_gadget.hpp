@@ -30,7 +30,10 @@ private:
     using super = GadgetPP<typename Poseidon::Field>;
     using LC = typename super::LC;
 
+    using super::assign;
+    using super::bound;
     using super::constrain;
+    using super::generate_bounded_witness;
     using super::val;
 
     static constexpr size_t INTER0_N = 3 * ROUNDS_N;
@@ -41,8 +44,31 @@ private:
 
     std::vector<PbVariablePP<Field>> inter[BRANCH_N];
 
+    // Terms of one full round, given the size of each branch (t)
+    static constexpr size_t full_round_terms(size_t t) { return BRANCH_N * (3 * t + 6); }
+
+    static constexpr size_t partial_rounds_terms()
+    {
+        return 3 * ROUNDS_P * BRANCH_N + 3 * ROUNDS_P * (ROUNDS_P + 1) / 2 + 6 * ROUNDS_P;
+    }
+
 public:
-    static size_t size() { return INTER0_N + (BRANCH_N - 1) * INTERk_N; }
+    static constexpr size_t size() { return INTER0_N + (BRANCH_N - 1) * INTERk_N; }
+
+    // CIRCUIT COST (what generate_r1cs_constraints() produces, without a protoboard, for the
+    // default max_terms = 0; measure_gadget_cost() reports a bounded circuit)
+    static constexpr size_t variables() { return size(); }
+
+    static constexpr size_t constraints() { return variables() + 1; }
+
+    static constexpr size_t nonzero_terms()
+    {
+        // Partial rounds only touch branch 0, so every branch grows by one variable per partial
+        // round until the next full round mixes them again. Assumes ROUNDS_f > 0.
+        return 3 * (2 * RATE + CAPACITY) + 6 * BRANCH_N +
+               (ROUNDS_F - 2) * full_round_terms(BRANCH_N + 1) + partial_rounds_terms() +
+               full_round_terms(BRANCH_N + 1 + ROUNDS_P) + BRANCH_N + 3;
+    }
 
     PoseidonGadget(libsnark::protoboard<Field> &pb, const BlockVar &in, const DigVar &out,
                    const std::string &annotation_prefix) :
@@ -71,7 +97,10 @@ public:
         {
             // ADD CONSTANTS
             for (size_t k = 0; k < BRANCH_N; ++k)
+            {
                 t[k] = t[k] + rc[ri++];
+                bound(t[k]);
+            }
 
             // FULL SBOX (x^5)
             for (size_t k = 0; k < BRANCH_N; ++k)
@@ -97,7 +126,10 @@ public:
         {
             // ADD CONSTANTS
             for (size_t k = 0; k < BRANCH_N; ++k)
+            {
                 t[k] = t[k] + rc[ri++];
+                bound(t[k]);
+            }
 
             // SBOX (x^5) for first element
             i[0] += constrain(t[0], t[0], inter[0][i[0]]);
@@ -122,7 +154,10 @@ public:
         {
             // ADD CONSTANTS
             for (size_t k = 0; k < BRANCH_N; ++k)
+            {
                 t[k] = t[k] + rc[ri++];
+                bound(t[k]);
+            }
 
             for (size_t k = 0; k < BRANCH_N; ++k)
             {
@@ -148,102 +183,22 @@ public:
 
     void generate_r1cs_witness()
     {
-        Field s[BRANCH_N]{};
-        Field t[BRANCH_N]{};
-        size_t i[BRANCH_N]{};
-        size_t ri = 0;
+        typename Hash::Sponge h{};
+        typename Hash::Trace trace;
 
-        for (size_t j = 0; j < RATE; ++j)
-            t[j] = val(in[j][0]);
+        for (size_t k = 0; k < BRANCH_N; ++k)
+            trace.resize(k, inter[k].size());
 
-        // INITIAL FULL LAYERS
-        for (size_t j = 0; j < ROUNDS_f; ++j)
-        {
-            // ADD CONSTANTS
-            for (size_t k = 0; k < BRANCH_N; ++k)
-                t[k] += rc[ri++];
-
-            // FULL SBOX (x^5)
-            for (size_t k = 0; k < BRANCH_N; ++k)
-            {
-                val(inter[k][i[k]]) = t[k] * t[k];
-                ++i[k];
-                val(inter[k][i[k]]) = val(inter[k][i[k] - 1]) * val(inter[k][i[k] - 1]);
-                ++i[k];
-                val(inter[k][i[k]]) = t[k] * val(inter[k][i[k] - 1]);
-                ++i[k];
-            }
-
-            // MDS multiplication
-            for (size_t k = 0; k < BRANCH_N; ++k)
-            {
-                s[k] = 0;
-                for (size_t l = 0; l < BRANCH_N; ++l)
-                    s[k] += mds[k * BRANCH_N + l] * val(inter[l][i[l] - 1]);
-            }
-
-            for (size_t k = 0; k < BRANCH_N; ++k)
-                t[k] = s[k];
-        }
-        
-
-        // PARTIAL LAYERS
-        for (size_t j = 0; j < ROUNDS_P; ++j)
-        {
-            // ADD CONSTANTS
-            for (size_t k = 0; k < BRANCH_N; ++k)
-                t[k] += rc[ri++];
-
-            // SBOX (x^5) for first element
-            val(inter[0][i[0]]) = t[0] * t[0];
-            ++i[0];
-            val(inter[0][i[0]]) = val(inter[0][i[0] - 1]) * val(inter[0][i[0] - 1]);
-            ++i[0];
-            val(inter[0][i[0]]) = t[0] * val(inter[0][i[0] - 1]);
-            ++i[0];
-            t[0] = val(inter[0][i[0] - 1]);
-
-            // MDS multiplication
-            for (size_t k = 0; k < BRANCH_N; ++k)
-            {
-                s[k] = 0;
-                for (size_t l = 0; l < BRANCH_N; ++l)
-                    s[k] += mds[k * BRANCH_N + l] * t[l];
-            }
-            for (size_t k = 0; k < BRANCH_N; ++k)
-                t[k] = s[k];
-        }
-        
-        // FINAL FULL LAYERS
-        for (size_t j = 0; j < ROUNDS_f; ++j)
-        {
-            // ADD CONSTANTS
-            for (size_t k = 0; k < BRANCH_N; ++k)
-                t[k] += rc[ri++];
+        for (size_t j = 0; j < RATE; ++j)
+            h[j] = val(in[j][0]);
 
-            // FULL SBOX (x^5)
-            for (size_t k = 0; k < BRANCH_N; ++k)
-            {
-                val(inter[k][i[k]]) = t[k] * t[k];
-                ++i[k];
-                val(inter[k][i[k]]) = val(inter[k][i[k] - 1]) * val(inter[k][i[k] - 1]);
-                ++i[k];
-                val(inter[k][i[k]]) = t[k] * val(inter[k][i[k] - 1]);
-                ++i[k];
-            }
+        // The native permutation records the S-box intermediates in the order of inter
+        Hash::hash_field(h, &trace);
 
-            // MDS multiplication
-            for (size_t k = 0; k < BRANCH_N; ++k)
-            {
-                s[k] = 0;
-                for (size_t l = 0; l < BRANCH_N; ++l)
-                    s[k] += mds[k * BRANCH_N + l] * val(inter[l][i[l] - 1]);
-            }
-
-            for (size_t k = 0; k < BRANCH_N; ++k)
-                t[k] = s[k];
-        }
+        for (size_t k = 0; k < BRANCH_N; ++k)
+            assign(inter[k], trace.data(k));
 
-        val(out[0]) = t[0];
+        val(out[0]) = h[0];
+        generate_bounded_witness();
     }
 };
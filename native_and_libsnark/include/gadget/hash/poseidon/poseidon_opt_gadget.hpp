@@ -0,0 +1,502 @@
+#pragma once
+
+#include "gadget/field_variable.hpp"
+#include "gadget/hash/poseidon/poseidon_gadget.hpp"
+#include "gadget/pb_variable_pp.hpp"
+
+#include <limits>
+#include <stdexcept>
+
+// fold argument of PoseidonOptGadget: the interval with the smallest constraints x nonzero terms,
+// even if it costs more constraints or terms than PoseidonGadget
+inline constexpr size_t POSEIDON_FOLD_MIN_PRODUCT = std::numeric_limits<size_t>::max();
+
+template<typename Poseidon, size_t fold = 0>
+class PoseidonOptGadget : public GadgetPP<typename Poseidon::Field>
+{
+    /* PoseidonOptGadget
+    * Same permutation as PoseidonGadget, but the partial rounds use the sparse form of the MDS
+    * (dense first row and column, identity elsewhere) and only the lane 0 round constant, as in
+    * Appendix B of the Poseidon paper. The last variable of each partial S-box is the next lane 0
+    * itself, the S-box output is an LC of it fed straight into lanes 1..t-1. These grow by one term
+    * per partial round and are materialized every `fold` partial rounds. 0 picks the interval with
+    * the smallest constraints x nonzero terms among those which cost no more constraints and terms
+    * than PoseidonGadget, POSEIDON_FOLD_MIN_PRODUCT drops that limit. The capacity lanes of the
+    * first round are constants, and the last S-box of lane 0 is merged with the output.
+    */
+public:
+    using Field = typename Poseidon::Field;
+    using Hash = Poseidon;
+    using DigVar = FieldVariable<Field>;
+    using BlockVar = std::array<DigVar, Hash::RATE>;
+
+    static constexpr size_t RATE = Hash::RATE;
+    static constexpr size_t CAPACITY = Hash::CAPACITY;
+    static constexpr size_t BRANCH_N = Hash::BRANCH_N;
+    static constexpr size_t ROUNDS_f = Hash::ROUNDS_f_N;
+    static constexpr size_t ROUNDS_F = Hash::ROUNDS_F_N;
+    static constexpr size_t ROUNDS_P = Hash::ROUNDS_P_N;
+    static constexpr size_t ROUNDS_N = Hash::ROUNDS_N;
+    static constexpr size_t DIGEST_SIZE = Hash::DIGEST_SIZE;
+    static constexpr size_t BLOCK_SIZE = Hash::BLOCK_SIZE;
+    static constexpr size_t DIGEST_VARS = 1;
+
+    static_assert(ROUNDS_f > 0, "The sparse form needs a full round before the partial rounds");
+
+    const BlockVar in;
+    const DigVar out;
+
+private:
+    using super = GadgetPP<typename Poseidon::Field>;
+    using LC = typename super::LC;
+
+    using super::constrain;
+    using super::val;
+
+    using Plain = PoseidonGadget<Poseidon>;
+
+    static constexpr size_t BRANCH_N1 = BRANCH_N - 1;
+
+    static constexpr auto &rc = Hash::round_c;
+    static constexpr auto &mds = Hash::mds_mat;
+
+    struct Sparse
+    {
+        std::array<Field, ROUNDS_F * BRANCH_N> full_c;  // full round constants
+        std::array<Field, ROUNDS_P> partial_c;          // lane 0 constants of the partial rounds
+        std::array<Field, BRANCH_N * BRANCH_N> pre_mat; // last initial full round matrix
+        std::array<Field, ROUNDS_P * BRANCH_N> row;     // first row of each sparse matrix
+        std::array<Field, ROUNDS_P * BRANCH_N1> col;    // first column (without [0][0])
+    };
+
+    std::vector<PbVariablePP<Field>> inter;
+
+    // Variables with lanes 1..t-1 materialized every f partial rounds
+    static constexpr size_t variables(size_t f)
+    {
+        size_t folds = ROUNDS_P ? (ROUNDS_P - 1) / f : 0;
+
+        return 3 * (ROUNDS_F * BRANCH_N - CAPACITY + ROUNDS_P) - 1 + BRANCH_N1 * folds;
+    }
+
+    // Terms of one S-box, given the size of its input
+    static constexpr size_t sbox_terms(size_t t) { return 3 * t + 6; }
+
+    static constexpr size_t nonzero_terms(size_t f)
+    {
+        // INITIAL FULL LAYERS (the capacity lanes of the first round are constants)
+        size_t terms = RATE * sbox_terms(2);
+
+        for (size_t j = 1; j < ROUNDS_f; ++j)
+            terms += BRANCH_N * sbox_terms((j > 1 ? BRANCH_N : RATE) + 1);
+
+        // Variables of every lane, lanes 1..t-1 share them through the partial rounds
+        size_t vars = ROUNDS_f > 1 ? BRANCH_N : RATE;
+        size_t t0 = vars + 1;
+        size_t tk = vars + 1;
+
+        // PARTIAL LAYERS: the output of a S-box is an LC of the next lane 0 and all lanes 1..t-1
+        for (size_t j = 0; j < ROUNDS_P; ++j, ++vars)
+        {
+            if (j && j % f == 0)
+            {
+                terms += BRANCH_N1 * (vars + 3);
+                vars = BRANCH_N1;
+            }
+
+            terms += 3 * (j ? 1 : vars + 1) + 7 + vars;
+            t0 = 2;
+            tk = vars + 2;
+        }
+
+        // FINAL FULL LAYERS, the last S-box of lane 0 computes out
+        for (size_t j = 0; j < ROUNDS_f; ++j)
+        {
+            if (j)
+                t0 = tk = BRANCH_N + 1;
+
+            terms += BRANCH_N1 * sbox_terms(tk) + sbox_terms(t0);
+        }
+
+        return terms + BRANCH_N - 1;
+    }
+
+    // Smallest constraints x nonzero terms, ties go to the longest interval. Unless min_product,
+    // intervals costing more constraints or terms than PoseidonGadget are skipped.
+    static constexpr size_t best_fold(bool min_product)
+    {
+        size_t best = ROUNDS_P ? ROUNDS_P : 1;
+
+        for (size_t f = ROUNDS_P; f-- > 1;)
+        {
+            if (!min_product && (variables(f) > Plain::variables() ||
+                                 nonzero_terms(f) > Plain::nonzero_terms()))
+                continue;
+
+            if (variables(f) * nonzero_terms(f) < variables(best) * nonzero_terms(best))
+                best = f;
+        }
+
+        return best;
+    }
+
+public:
+    static constexpr size_t FOLD = fold == POSEIDON_FOLD_MIN_PRODUCT ? best_fold(true)
+                                   : fold                            ? fold
+                                                                     : best_fold(false);
+
+    static constexpr size_t size() { return variables(FOLD); }
+
+    // CIRCUIT COST (what generate_r1cs_constraints() produces, without a protoboard)
+    static constexpr size_t variables() { return size(); }
+
+    static constexpr size_t constraints() { return variables() + 1; }
+
+    static constexpr size_t nonzero_terms() { return nonzero_terms(FOLD); }
+
+    PoseidonOptGadget(libsnark::protoboard<Field> &pb, const BlockVar &in, const DigVar &out,
+                      const std::string &annotation_prefix) :
+        super{pb, annotation_prefix}, in{in}, out{out}
+    {
+        for (size_t i = 0; i < size(); ++i)
+            inter.emplace_back(pb, FMT(""));
+    }
+
+    void generate_r1cs_constraints()
+    {
+        const Sparse &sp = sparse();
+        LC s[BRANCH_N]{};
+        LC t[BRANCH_N]{};
+        size_t i = 0;
+
+        for (size_t j = 0; j < RATE; ++j)
+            t[j] = in[j][0];
+
+        // INITIAL FULL LAYERS
+        for (size_t j = 0; j < ROUNDS_f; ++j)
+        {
+            const auto *m = j < ROUNDS_f - 1 || !ROUNDS_P ? mds.data() : sp.pre_mat.data();
+
+            // FULL SBOX (x^5), the capacity lanes of the first round are constants
+            for (size_t k = 0; k < BRANCH_N; ++k)
+            {
+                if (!j && k >= RATE)
+                {
+                    Field x{sp.full_c[k]};
+                    Hash::fifth(x);
+                    t[k] = LC{x};
+                    continue;
+                }
+
+                t[k] = t[k] + sp.full_c[j * BRANCH_N + k];
+                i += sbox(t[k], i);
+                t[k] = inter[i - 1];
+            }
+
+            // MDS multiplication
+            for (size_t k = 0; k < BRANCH_N; ++k)
+            {
+                s[k] = 0;
+                for (size_t l = 0; l < BRANCH_N; ++l)
+                    s[k] = s[k] + m[k * BRANCH_N + l] * t[l];
+            }
+
+            for (size_t k = 0; k < BRANCH_N; ++k)
+                t[k] = s[k];
+        }
+
+        // PARTIAL LAYERS
+        if constexpr (ROUNDS_P > 0)
+            t[0] = t[0] + sp.partial_c[0];
+
+        for (size_t j = 0; j < ROUNDS_P; ++j)
+        {
+            // FOLD lanes 1..t-1 into fresh variables
+            if (j && j % FOLD == 0)
+                for (size_t k = 1; k < BRANCH_N; ++k)
+                {
+                    i += constrain(t[k], 1, inter[i]);
+                    t[k] = inter[i - 1];
+                }
+
+            // SBOX (x^5) for first element, the output variable is the next lane 0:
+            // y = row * (x, t[1..]) + c <==> x = (y - c - row[1..] * t[1..]) / row[0]
+            Field inv{field_inverse(sp.row[j * BRANCH_N])};
+            LC x{inv * (inter[i + 2] - next_constant(j))};
+
+            for (size_t k = 1; k < BRANCH_N; ++k)
+                x = x - (inv * sp.row[j * BRANCH_N + k]) * t[k];
+
+            i += constrain(t[0], t[0], inter[i]);
+            i += constrain(inter[i - 1], inter[i - 1], inter[i]);
+            i += constrain(t[0], inter[i - 1], x);
+            t[0] = inter[i - 1];
+
+            // SPARSE MDS multiplication, lane 0 is already done
+            for (size_t k = 1; k < BRANCH_N; ++k)
+                t[k] = t[k] + sp.col[j * BRANCH_N1 + k - 1] * x;
+        }
+
+        // FINAL FULL LAYERS
+        for (size_t j = 0; j < ROUNDS_f; ++j)
+        {
+            bool last = j == ROUNDS_f - 1;
+
+            // FULL SBOX (x^5), lane 0 of the last round comes last
+            for (size_t k = last; k < BRANCH_N; ++k)
+            {
+                t[k] = t[k] + sp.full_c[(ROUNDS_f + j) * BRANCH_N + k];
+                i += sbox(t[k], i);
+                t[k] = inter[i - 1];
+            }
+
+            if (last)
+                break;
+
+            // MDS multiplication
+            for (size_t k = 0; k < BRANCH_N; ++k)
+            {
+                s[k] = 0;
+                for (size_t l = 0; l < BRANCH_N; ++l)
+                    s[k] = s[k] + mds[k * BRANCH_N + l] * t[l];
+            }
+
+            for (size_t k = 0; k < BRANCH_N; ++k)
+                t[k] = s[k];
+        }
+
+        // out = M[0] * sbox(t) <==> sbox(t[0]) = (out - M[0][1..] * sbox(t[1..])) / M[0][0]
+        Field inv{field_inverse(mds[0])};
+        LC x0{inv * out[0]};
+
+        for (size_t k = 1; k < BRANCH_N; ++k)
+            x0 = x0 - (inv * mds[k]) * t[k];
+
+        t[0] = t[0] + sp.full_c[(ROUNDS_F - 1) * BRANCH_N];
+        constrain(t[0], t[0], inter[i]);
+        constrain(inter[i], inter[i], inter[i + 1]);
+        constrain(t[0], inter[i + 1], x0);
+    }
+
+    void generate_r1cs_witness()
+    {
+        const Sparse &sp = sparse();
+        typename Hash::Sponge h{};
+        typename Hash::Trace trace;
+        Field t[BRANCH_N]{};
+        size_t i = 0;
+
+        for (size_t j = 0; j < RATE; ++j)
+            h[j] = val(in[j][0]);
+
+        // The native permutation records x^2, x^4 and x^5 of every S-box. The sparse form has the
+        // same S-box inputs, only lanes 1..t-1 of the partial rounds are its own.
+        for (size_t k = 0; k < BRANCH_N; ++k)
+            trace.resize(k, trace_size(k));
+
+        Hash::hash_field(h, &trace);
+
+        for (size_t k = 0; k < BRANCH_N; ++k)
+            trace.resize(k, trace_size(k));
+
+        // INITIAL FULL LAYERS, the capacity lanes of the first round are constants
+        for (size_t j = 0; j < ROUNDS_f; ++j)
+            for (size_t k = 0; k < BRANCH_N; ++k)
+            {
+                const Field *x = trace.take(k, 3);
+
+                if (j || k < RATE)
+                    for (size_t l = 0; l < 3; ++l)
+                        val(inter[i++]) = x[l];
+
+                t[k] = x[2];
+            }
+
+        // Lanes 1..t-1 after the last initial matrix
+        if constexpr (ROUNDS_P > 0)
+        {
+            Field s[BRANCH_N]{};
+
+            for (size_t k = 1; k < BRANCH_N; ++k)
+                for (size_t l = 0; l < BRANCH_N; ++l)
+                    s[k] += sp.pre_mat[k * BRANCH_N + l] * t[l];
+
+            for (size_t k = 1; k < BRANCH_N; ++k)
+                t[k] = s[k];
+        }
+
+        // PARTIAL LAYERS
+        for (size_t j = 0; j < ROUNDS_P; ++j)
+        {
+            // FOLD lanes 1..t-1 into fresh variables
+            if (j && j % FOLD == 0)
+                for (size_t k = 1; k < BRANCH_N; ++k)
+                    val(inter[i++]) = t[k];
+
+            // SBOX (x^5) for first element, then the SPARSE MDS multiplication
+            const Field *x = trace.take(0, 3);
+            Field y{sp.row[j * BRANCH_N] * x[2] + next_constant(j)};
+
+            for (size_t k = 1; k < BRANCH_N; ++k)
+            {
+                y += sp.row[j * BRANCH_N + k] * t[k];
+                t[k] += sp.col[j * BRANCH_N1 + k - 1] * x[2];
+            }
+
+            val(inter[i]) = x[0];
+            val(inter[i + 1]) = x[1];
+            val(inter[i + 2]) = y;
+            i += 3;
+        }
+
+        // FINAL FULL LAYERS, lane 0 of the last round comes last
+        for (size_t j = 0; j < ROUNDS_f; ++j)
+            for (size_t k = j == ROUNDS_f - 1; k < BRANCH_N; ++k)
+            {
+                const Field *x = trace.take(k, 3);
+
+                for (size_t l = 0; l < 3; ++l)
+                    val(inter[i++]) = x[l];
+            }
+
+        // last S-box of lane 0 without its output variable
+        const Field *x = trace.take(0, 3);
+
+        val(inter[i]) = x[0];
+        val(inter[i + 1]) = x[1];
+        val(out[0]) = h[0];
+    }
+
+private:
+    // Constant of the lane 0 S-box after partial round j (the full rounds add their own)
+    static Field next_constant(size_t j)
+    {
+        return j + 1 < ROUNDS_P ? sparse().partial_c[j + 1] : Field{0};
+    }
+
+    // S-box intermediates the native permutation records on lane k
+    static constexpr size_t trace_size(size_t k) { return 3 * (ROUNDS_F + (k ? 0 : ROUNDS_P)); }
+
+    // x^5 with its input as an arbitrary LC, the output is inter[i + 2]
+    size_t sbox(const LC &t, size_t i)
+    {
+        constrain(t, t, inter[i]);
+        constrain(inter[i], inter[i], inter[i + 1]);
+        constrain(t, inter[i + 1], inter[i + 2]);
+
+        return 3;
+    }
+
+    // Round constants and matrices of the sparse form, computed once
+    static const Sparse &sparse()
+    {
+        static const Sparse s{make_sparse()};
+
+        return s;
+    }
+
+    static Sparse make_sparse()
+    {
+        Sparse s;
+        std::array<Field, BRANCH_N> acc{};
+        std::array<Field, BRANCH_N> c;
+        std::array<Field, BRANCH_N * BRANCH_N> d{mds};
+
+        // Lanes 1..t-1 skip the S-box, so their constants can be moved through the MDS up to the
+        // first final full round
+        for (size_t j = 0; j < ROUNDS_P; ++j)
+        {
+            for (size_t k = 0; k < BRANCH_N; ++k)
+                c[k] = rc[(ROUNDS_f + j) * BRANCH_N + k] + acc[k];
+
+            s.partial_c[j] = c[0];
+            c[0] = 0;
+
+            for (size_t k = 0; k < BRANCH_N; ++k)
+            {
+                acc[k] = 0;
+                for (size_t l = 0; l < BRANCH_N; ++l)
+                    acc[k] += mds[k * BRANCH_N + l] * c[l];
+            }
+        }
+
+        for (size_t j = 0; j < ROUNDS_f; ++j)
+            for (size_t k = 0; k < BRANCH_N; ++k)
+            {
+                s.full_c[j * BRANCH_N + k] = rc[j * BRANCH_N + k];
+                s.full_c[(ROUNDS_f + j) * BRANCH_N + k] =
+                    rc[(ROUNDS_f + ROUNDS_P + j) * BRANCH_N + k] + (j ? Field{0} : acc[k]);
+            }
+
+        // Walking backwards, D = S * diag(1, D'): the diagonal block commutes with the lane 0 S-box
+        // and joins the previous round, D <- diag(1, D') * M. S keeps the first column of D and has
+        // b = D'^-T * D[0][1..] as first row. What is left of D replaces the last initial MDS.
+        for (size_t j = ROUNDS_P; j-- > 0;)
+        {
+            std::array<Field, BRANCH_N1 * BRANCH_N> a;
+
+            s.row[j * BRANCH_N] = d[0];
+            for (size_t k = 0; k < BRANCH_N1; ++k)
+            {
+                s.col[j * BRANCH_N1 + k] = d[(k + 1) * BRANCH_N];
+
+                // augmented system D'^T b = D[0][1..]
+                for (size_t l = 0; l < BRANCH_N1; ++l)
+                    a[k * BRANCH_N + l] = d[(l + 1) * BRANCH_N + k + 1];
+                a[k * BRANCH_N + BRANCH_N1] = d[k + 1];
+            }
+
+            solve(a);
+
+            for (size_t k = 0; k < BRANCH_N1; ++k)
+                s.row[j * BRANCH_N + k + 1] = a[k * BRANCH_N + BRANCH_N1];
+
+            std::array<Field, BRANCH_N * BRANCH_N> next;
+
+            for (size_t k = 0; k < BRANCH_N; ++k)
+                for (size_t l = 0; l < BRANCH_N; ++l)
+                {
+                    next[k * BRANCH_N + l] = k ? Field{0} : mds[l];
+                    for (size_t m = 1; k && m < BRANCH_N; ++m)
+                        next[k * BRANCH_N + l] += d[k * BRANCH_N + m] * mds[m * BRANCH_N + l];
+                }
+
+            d = next;
+        }
+
+        s.pre_mat = d;
+
+        return s;
+    }
+
+    // Gauss-Jordan elimination on an augmented (BRANCH_N - 1) x BRANCH_N system, in place
+    static void solve(std::array<Field, BRANCH_N1 * BRANCH_N> &a)
+    {
+        for (size_t k = 0; k < BRANCH_N1; ++k)
+        {
+            size_t p = k;
+            while (p < BRANCH_N1 && a[p * BRANCH_N + k].is_zero())
+                ++p;
+
+            if (p == BRANCH_N1)
+                throw std::runtime_error{"PoseidonOptGadget: the MDS matrix has no sparse form"};
+
+            for (size_t l = 0; l < BRANCH_N; ++l)
+                std::swap(a[k * BRANCH_N + l], a[p * BRANCH_N + l]);
+
+            Field inv{field_inverse(a[k * BRANCH_N + k])};
+            for (size_t l = 0; l < BRANCH_N; ++l)
+                a[k * BRANCH_N + l] *= inv;
+
+            for (size_t r = 0; r < BRANCH_N1; ++r)
+            {
+                if (r == k)
+                    continue;
+
+                Field f{a[r * BRANCH_N + k]};
+                for (size_t l = 0; l < BRANCH_N; ++l)
+                    a[r * BRANCH_N + l] -= f * a[k * BRANCH_N + l];
+            }
+        }
+    }
+};
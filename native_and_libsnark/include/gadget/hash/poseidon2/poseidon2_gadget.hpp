@@ -28,6 +28,7 @@ private:
     using super = GadgetPP<typename Poseidon2::Field>;
     using LC = typename super::LC;
 
+    using super::assign;
     using super::constrain;
     using super::val;
 
@@ -40,8 +41,32 @@ private:
 
     std::vector<PbVariablePP<Field>> inter[BRANCH_N];
 
+    // Terms of one full round, given the size of each branch (t)
+    static constexpr size_t full_round_terms(size_t t) { return BRANCH_N * (3 * t + 6); }
+
+    static constexpr size_t partial_rounds_terms()
+    {
+        return 3 * ROUNDS_P * BRANCH_N + 3 * ROUNDS_P * (ROUNDS_P + 1) / 2 + 6 * ROUNDS_P;
+    }
+
 public:
-    static size_t size() { return INTER0_N + (BRANCH_N - 1) * INTERk_N; }
+    static constexpr size_t size() { return INTER0_N + (BRANCH_N - 1) * INTERk_N; }
+
+    // CIRCUIT COST (what generate_r1cs_constraints() produces, without a protoboard)
+    static constexpr size_t variables() { return size(); }
+
+    static constexpr size_t constraints() { return variables() + 1; }
+
+    static constexpr size_t nonzero_terms()
+    {
+        // Both linear layers make every branch depend on all of them, partial rounds add one
+        // variable each. Without full rounds the feed-forward input is already in branch 0.
+        if constexpr (ROUNDS_f == 0)
+            return partial_rounds_terms() + BRANCH_N + ROUNDS_P + 2;
+        else
+            return (ROUNDS_F - 1) * full_round_terms(BRANCH_N + 1) + partial_rounds_terms() +
+                   full_round_terms(BRANCH_N + 1 + ROUNDS_P) + BRANCH_N + 3;
+    }
 
     Poseidon2Gadget(libsnark::protoboard<Field> &pb, const BlockVar &in, const DigVar &out,
                     const std::string &annotation_prefix) :
@@ -210,6 +235,12 @@ public:
         std::array<Field, BRANCH_N> t{};
         std::array<size_t, BRANCH_N> i{};
 
+        // The whole trace is computed first, then written to the protoboard lane by lane
+        std::array<std::vector<Field>, BRANCH_N> w;
+
+        for (size_t k = 0; k < BRANCH_N; ++k)
+            w[k].resize(inter[k].size());
+
         for (size_t j = 0; j < BRANCH_N; ++j)
             t[j] = val(in[j][0]);
 
@@ -226,17 +257,17 @@ public:
             // FULL SBOX (x^5)
             for (size_t k = 0; k < BRANCH_N; ++k)
             {
-                val(inter[k][i[k]]) = t[k] * t[k];
+                w[k][i[k]] = t[k] * t[k];
                 ++i[k];
-                val(inter[k][i[k]]) = val(inter[k][i[k] - 1]) * val(inter[k][i[k] - 1]);
+                w[k][i[k]] = w[k][i[k] - 1] * w[k][i[k] - 1];
                 ++i[k];
-                val(inter[k][i[k]]) = t[k] * val(inter[k][i[k] - 1]);
+                w[k][i[k]] = t[k] * w[k][i[k] - 1];
                 ++i[k];
             }
 
             // MDS multiplication
             for (size_t k = 0; k < BRANCH_N; ++k)
-                t[k] = val(inter[k][i[k] - 1]);
+                t[k] = w[k][i[k] - 1];
             EXT_MDS_MUL();
         }
 
@@ -247,15 +278,15 @@ public:
             t[0] += int_rc[j];
 
             // SBOX (x^5) for first element
-            val(inter[0][i[0]]) = t[0] * t[0];
+            w[0][i[0]] = t[0] * t[0];
             ++i[0];
-            val(inter[0][i[0]]) = val(inter[0][i[0] - 1]) * val(inter[0][i[0] - 1]);
+            w[0][i[0]] = w[0][i[0] - 1] * w[0][i[0] - 1];
             ++i[0];
-            val(inter[0][i[0]]) = t[0] * val(inter[0][i[0] - 1]);
+            w[0][i[0]] = t[0] * w[0][i[0] - 1];
             ++i[0];
 
             // MDS multiplication
-            t[0] = val(inter[0][i[0] - 1]);
+            t[0] = w[0][i[0] - 1];
             INT_MDS_MUL();
         }
 
@@ -269,20 +300,23 @@ public:
             // FULL SBOX (x^5)
             for (size_t k = 0; k < BRANCH_N; ++k)
             {
-                val(inter[k][i[k]]) = t[k] * t[k];
+                w[k][i[k]] = t[k] * t[k];
                 ++i[k];
-                val(inter[k][i[k]]) = val(inter[k][i[k] - 1]) * val(inter[k][i[k] - 1]);
+                w[k][i[k]] = w[k][i[k] - 1] * w[k][i[k] - 1];
                 ++i[k];
-                val(inter[k][i[k]]) = t[k] * val(inter[k][i[k] - 1]);
+                w[k][i[k]] = t[k] * w[k][i[k] - 1];
                 ++i[k];
             }
 
             // MDS multiplication
             for (size_t k = 0; k < BRANCH_N; ++k)
-                t[k] = val(inter[k][i[k] - 1]);
+                t[k] = w[k][i[k] - 1];
             EXT_MDS_MUL();
         }
 
+        for (size_t k = 0; k < BRANCH_N; ++k)
+            assign(inter[k], w[k].data());
+
         val(out[0]) = t[0] + val(in[0][0]);
     }
 
@@ -27,6 +27,7 @@ private:
     using super = GadgetPP<typename Rescue::Field>;
     using LC = typename super::LC;
 
+    using super::assign;
     using super::constrain;
     using super::val;
 
@@ -40,7 +41,19 @@ private:
     std::vector<PbVariablePP<Field>> inter[BRANCH_N];
 
 public:
-    static size_t size() { return INTER_N * BRANCH_N; }
+    static constexpr size_t size() { return INTER_N * BRANCH_N; }
+
+    // CIRCUIT COST (what generate_r1cs_constraints() produces, without a protoboard)
+    static constexpr size_t variables() { return size(); }
+
+    static constexpr size_t constraints() { return variables() + 1; }
+
+    static constexpr size_t nonzero_terms()
+    {
+        // direct S-boxes see the bare inputs in the first round, the mixed state afterwards
+        return 3 * RATE + 6 * BRANCH_N + (ROUNDS_N - 1) * BRANCH_N * (3 * BRANCH_N + 9) +
+               ROUNDS_N * BRANCH_N * (BRANCH_N + 9) + BRANCH_N + 3;
+    }
 
     RescueGadget(libsnark::protoboard<Field> &pb, const BlockVar &in, const DigVar &out,
                  const std::string &annotation_prefix) :
@@ -118,71 +131,21 @@ public:
 
     void generate_r1cs_witness()
     {
-        size_t i[BRANCH_N]{};
-        std::array<Field, BRANCH_N> t{};
-
-        for (size_t j = 0; j < RATE; ++j)
-            t[j] = val(in[j][0]);
-
-        for (size_t j = 0; j < ROUNDS_N; ++j)
-        {
-            // Direct SBOX (x -> x^a), assume a == 5
-            for (size_t k = 0; k < BRANCH_N; ++k)
-            {
-                // x^2
-                val(inter[k][i[k]]) = t[k] * t[k];
-                ++i[k];
-                // x^4
-                val(inter[k][i[k]]) = val(inter[k][i[k] - 1]) * val(inter[k][i[k] - 1]);
-                ++i[k];
-                // x^5
-                val(inter[k][i[k]]) = val(inter[k][i[k] - 1]) * t[k];
-                ++i[k];
-            }
+        typename Hash::Sponge h{};
+        typename Hash::Trace trace;
 
-            // reset temporaries
-            for (size_t k = 0; k < BRANCH_N; ++k)
-                t[k] = 0;
-
-            // MDS MULTIPLICATION
-            for (size_t k = 0; k < BRANCH_N; ++k)
-                for (size_t l = 0; l < BRANCH_N; ++l)
-                    t[k] = t[k] + mat[k * BRANCH_N + l] * val(inter[l][i[l] - 1]);
+        for (size_t k = 0; k < BRANCH_N; ++k)
+            trace.resize(k, inter[k].size());
 
-            // ADD FIRST CONSTANTS
-            for (size_t k = 0; k < BRANCH_N; ++k)
-                t[k] = t[k] + rc[j * 2 * BRANCH_N + k];
-
-            // Inverse SBOX (x -> x^{1/a}), assume a == 5
-            for (size_t k = 0; k < BRANCH_N; ++k)
-            {
-                // x^{1/a} == y    <==>    y^a == x
-                val(inter[k][i[k]]) = t[k];
-                Hash::raise_alpha_inv(val(inter[k][i[k]]));
-                ++i[k];
-                // y^2
-                val(inter[k][i[k]]) = val(inter[k][i[k] - 1]) * val(inter[k][i[k] - 1]);
-                ++i[k];
-                // y^4
-                val(inter[k][i[k]]) = val(inter[k][i[k] - 1]) * val(inter[k][i[k] - 1]);
-                ++i[k];
-            }
+        for (size_t j = 0; j < RATE; ++j)
+            h[j] = val(in[j][0]);
 
-            // reset temporaries
-            for (size_t k = 0; k < BRANCH_N; ++k)
-                t[k] = 0;
+        // The native permutation records the S-box intermediates in the order of inter
+        Hash::hash_field(h, &trace);
 
-            // MDS MULTIPLICATION
-            for (size_t k = 0; k < BRANCH_N; ++k)
-                for (size_t l = 0; l < BRANCH_N; ++l)
-                    t[k] = t[k] + mat[k * BRANCH_N + l] * val(inter[l][i[l] - 3]);
+        for (size_t k = 0; k < BRANCH_N; ++k)
+            assign(inter[k], trace.data(k));
 
-            // ADD SECOND CONSTANTS
-            for (size_t k = 0; k < BRANCH_N; ++k)
-                t[k] = t[k] + rc[BRANCH_N + j * 2 * BRANCH_N + k];
-        }
-
-        // bind output
-        val(out[0]) = t[0];
+        val(out[0]) = h[0];
     }
 };
@@ -26,6 +26,12 @@ public:
 
     static constexpr size_t size() { return 27280; }
 
+    // libsnark only publishes the constraint count (expected_constraints()), the other two are
+    // counted from its SHA-256 components (test_tree_size checks all three)
+    static constexpr size_t constraints() { return size(); }
+    static constexpr size_t variables() { return 24792; }
+    static constexpr size_t nonzero_terms() { return 163584; }
+
     void generate_r1cs_constraints() { super::generate_r1cs_constraints(true); }
     void generate_r1cs_witness() { super::generate_r1cs_witness(); }
 };
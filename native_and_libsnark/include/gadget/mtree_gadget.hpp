@@ -4,10 +4,26 @@
 #include "gadget/field_variable.hpp"
 #include "gadget/pb_variable_pp.hpp"
 #include "util/array_utils.hpp"
+#include "util/const_math.hpp"
 
-template<size_t height, typename GadHashT>
-class MTreeGadget : public GadgetPP<typename GadHashT::Field>
+#include <stdexcept>
+
+// How every level of the tree places the previous digest among its children
+enum class MTreeSelector
+{
+    ONEHOT, // ARITY - 1 flags, fresh children copied from the previous digest or the siblings
+    MUX     // log2(ARITY) index bits, the siblings are hashed as they are and a multiplexer tree
+            // checks that the indexed one is the previous digest
+};
+
+template<typename GadHashT, MTreeSelector selector = MTreeSelector::ONEHOT>
+class MTreeLevelsGadget : public GadgetPP<typename GadHashT::Field>
 {
+    /* MTreeLevelsGadget
+    * The levels of a Merkle path, one per sibling level: each one selects its children from the
+    * previous digest and the siblings, then hashes them. The height is taken from the number of
+    * sibling levels, MTreeGadget fixes it at compile time, FixedMTreeGadget leaves it to runtime.
+    */
 public:
     using super = GadgetPP<typename GadHashT::Field>;
     using GadHash = GadHashT;
@@ -16,11 +32,15 @@ public:
     using super::constrain;
     using super::val;
 
-    static constexpr size_t HEIGHT = height;
     static constexpr size_t DIGEST_VARS = GadHash::DIGEST_VARS;
     static constexpr size_t DIGEST_SIZE = GadHash::DIGEST_SIZE;
     static constexpr size_t ARITY = GadHash::BLOCK_SIZE / GadHash::DIGEST_SIZE;
+    static constexpr size_t LOG_ARITY = ilog2(ARITY);
     static constexpr bool HASH_ISBOOLEAN = DIGEST_SIZE < DIGEST_VARS;
+    static constexpr MTreeSelector SELECTOR = selector;
+
+    static_assert(SELECTOR != MTreeSelector::MUX || ARITY == 1ULL << LOG_ARITY,
+                  "MTreeSelector::MUX requires a power of two arity");
 
     using LC = libsnark::linear_combination<Field>;
     using PbVar = PbVariablePP<Field>;
@@ -29,61 +49,151 @@ public:
     using Protoboard = libsnark::protoboard<Field>;
     using Level = std::array<DigVar, ARITY>;
     using BoolLevel = std::array<PbVar, ARITY - 1>;
+    using IndexLevel = std::array<PbVar, LOG_ARITY>;
 
 private:
-    static constexpr size_t HEIGHT1 = HEIGHT - 1;
     static constexpr size_t ARITY1 = ARITY - 1;
+    static constexpr size_t ARITY2 = ARITY - 2; // inner nodes of a multiplexer tree
 
     DigVar trans;
     std::vector<Level> other;
     std::vector<DigVar> inter;
-    std::vector<Level> children;
     std::vector<GadHash> hash;
+
+    // ONEHOT
+    std::vector<Level> children;
     std::vector<BoolLevel> active;
 
+    // MUX
+    std::vector<IndexLevel> index;
+    std::vector<std::vector<PbVar>> mux;
+
 public:
     const DigVar out;
 
-    MTreeGadget(Protoboard &pb, const DigVar &out, const DigVar &trans,
-                const std::vector<Level> &other, const std::string &ap) :
+    // CIRCUIT COST (a tree of height has height - 1 levels, each one selects the children and
+    // hashes them; every level but the last writes to an intermediate digest, the last to out)
+    static constexpr size_t levels(size_t height) { return height > 1 ? height - 1 : 0; }
+
+    static constexpr size_t variables(size_t height)
+    {
+        const size_t n = levels(height);
+        const size_t inter_vars = (n ? n - 1 : 0) * DIGEST_VARS;
+
+        if constexpr (SELECTOR == MTreeSelector::MUX)
+            return n * (LOG_ARITY + ARITY2 * DIGEST_VARS + GadHash::variables()) + inter_vars;
+        else
+            return n * (ARITY * DIGEST_VARS + ARITY1 + GadHash::variables()) + inter_vars;
+    }
+
+    static constexpr size_t constraints(size_t height)
+    {
+        if constexpr (SELECTOR == MTreeSelector::MUX)
+            return levels(height) * (LOG_ARITY + ARITY1 * DIGEST_VARS + GadHash::constraints());
+        else
+            return levels(height) * (ARITY1 * (DIGEST_VARS + 1) + (ARITY > 2) + DIGEST_VARS +
+                                     GadHash::constraints());
+    }
+
+    static constexpr size_t nonzero_terms(size_t height)
+    {
+        if constexpr (SELECTOR == MTreeSelector::MUX)
+            return levels(height) *
+                   (3 * LOG_ARITY + 5 * ARITY1 * DIGEST_VARS + GadHash::nonzero_terms());
+        else
+            return levels(height) * (ARITY1 * (5 * DIGEST_VARS + 3) + (ARITY > 2) * 3 * ARITY +
+                                     (ARITY + 4) * DIGEST_VARS + GadHash::nonzero_terms());
+    }
+
+    MTreeLevelsGadget(Protoboard &pb, const DigVar &out, const DigVar &trans,
+                      const std::vector<Level> &other, const std::string &ap) :
         super{pb, ap}, //
         trans{trans},  //
         other{other},  //
         out{out}       //
     {
-        for (size_t i = 0; i < HEIGHT1; ++i)
+        // Without a level, out would not be bound to trans at all
+        if (other.empty())
+            throw std::invalid_argument{"MTreeGadget: the tree height must be at least 2"};
+
+        for (size_t i = 0; i < other.size(); ++i)
         {
-            // inputs for the hash gadget
-            children.emplace_back(make_uniform_array<Level>(pb, DIGEST_VARS, FMT("")));
-            // active index for next level (i.e. where the previous level was output)
-            active.emplace_back(make_uniform_array<BoolLevel>(pb, FMT("")));
+            if constexpr (SELECTOR == MTreeSelector::MUX)
+            {
+                // bits of the active index for next level
+                index.emplace_back(make_uniform_array<IndexLevel>(pb, FMT("")));
+                // inner nodes of the multiplexer trees, one per digest variable
+                mux.emplace_back();
+                for (size_t j = 0; j < ARITY2 * DIGEST_VARS; ++j)
+                    mux[i].emplace_back(pb, FMT(""));
+            }
+            else
+            {
+                // inputs for the hash gadget
+                children.emplace_back(make_uniform_array<Level>(pb, DIGEST_VARS, FMT("")));
+                // active index for next level (i.e. where the previous level was output)
+                active.emplace_back(make_uniform_array<BoolLevel>(pb, FMT("")));
+            }
 
-            // result of the hash
-            inter.emplace_back(pb, DIGEST_VARS, FMT(""));
+            // hash gadget, the last one writes straight to out
+            const Level &in = SELECTOR == MTreeSelector::MUX ? this->other[i] : children[i];
 
-            // hash gadget
-            if (i == HEIGHT1 - 1)
-                hash.emplace_back(pb, children[i], out, FMT(""));
+            if (i == other.size() - 1)
+                hash.emplace_back(pb, in, out, FMT(""));
             else
-                hash.emplace_back(pb, children[i], inter[i], FMT(""));
+            {
+                inter.emplace_back(pb, DIGEST_VARS, FMT(""));
+                hash.emplace_back(pb, in, inter[i], FMT(""));
+            }
         }
     }
 
     void generate_r1cs_constraints()
     {
-        // Constraints for layers
+        for (size_t i = 0; i < hash.size(); ++i)
+        {
+            const DigVar &prev = i ? inter[i - 1] : trans;
+
+            if constexpr (SELECTOR == MTreeSelector::MUX)
+                constrain_mux(i, prev);
+            else
+                constrain_onehot(i, prev);
+
+            hash[i].generate_r1cs_constraints();
+        }
+    }
+
+    void generate_r1cs_witness(size_t idx)
+    {
+        for (size_t i = 0; i < hash.size(); ++i, idx /= ARITY)
+        {
+            const DigVar &prev = i ? inter[i - 1] : trans;
+            size_t rem = idx % ARITY;
+
+            if constexpr (SELECTOR == MTreeSelector::MUX)
+                witness_mux(i, rem);
+            else
+                witness_onehot(i, prev, rem);
+
+            hash[i].generate_r1cs_witness();
+        }
+    }
+
+private:
+    void constrain_onehot(size_t i, const DigVar &prev)
+    {
         LC sum{0};
 
         for (size_t j = 0; j < ARITY1; ++j)
         {
-            constrain(active[0][j], active[0][j], active[0][j]);
-            sum = sum + active[0][j];
+            constrain(active[i][j], active[i][j], active[i][j]);
+            sum = sum + active[i][j];
 
             // iterate over all pieces of a single node
             // z = c ? x : y <==> z = xc + y(1 - c) <==> z - y = c(x - y)
             for (size_t k = 0; k < DIGEST_VARS; ++k)
-                constrain(active[0][j], trans[k] - other[0][j][k],
-                          children[0][j][k] - other[0][j][k]);
+                constrain(active[i][j], prev[k] - other[i][j][k],
+                          children[i][j][k] - other[i][j][k]);
         }
 
         if constexpr (ARITY > 2) // sum = 0|1
@@ -91,88 +201,88 @@ public:
 
         // last branch
         for (size_t k = 0; k < DIGEST_VARS; ++k)
-            constrain(1 - sum, trans[k] - other[0][ARITY1][k],
-                      children[0][ARITY1][k] - other[0][ARITY1][k]);
+            constrain(1 - sum, prev[k] - other[i][ARITY1][k],
+                      children[i][ARITY1][k] - other[i][ARITY1][k]);
+    }
 
-        hash[0].generate_r1cs_constraints();
+    void constrain_mux(size_t i, const DigVar &prev)
+    {
+        for (size_t j = 0; j < LOG_ARITY; ++j)
+            constrain(index[i][j], index[i][j], index[i][j]);
 
-        for (size_t i = 1; i < HEIGHT1; ++i)
+        // One multiplexer tree per digest variable, bit j picks between siblings 2^j apart.
+        // z = c ? y : x <==> z - x = c(y - x); the root is not allocated, it must be prev
+        for (size_t k = 0, n = 0; k < DIGEST_VARS; ++k)
         {
-            sum = 0;
+            std::array<LC, ARITY> node;
 
-            for (size_t j = 0; j < ARITY1; ++j)
-            {
-                constrain(active[i][j], active[i][j], active[i][j]);
-                sum = sum + active[i][j];
-                // iterate over all pieces of a single node
-                // z = c ? x : y <==> z = xc + y(1 - c) <==> z - y = c(x - y)
-                for (size_t k = 0; k < DIGEST_VARS; ++k)
-                    constrain(active[i][j], inter[i - 1][k] - other[i][j][k],
-                              children[i][j][k] - other[i][j][k]);
-            }
-
-            if constexpr (ARITY > 2) // sum = 0|1
-                constrain(sum, sum, sum);
+            for (size_t j = 0; j < ARITY; ++j)
+                node[j] = other[i][j][k];
 
-            // last branch
-            for (size_t k = 0; k < DIGEST_VARS; ++k)
-                constrain(1 - sum, inter[i - 1][k] - other[i][ARITY1][k],
-                          children[i][ARITY1][k] - other[i][ARITY1][k]);
+            for (size_t j = 0, len = ARITY; len > 2; ++j, len >>= 1)
+                for (size_t l = 0; l < len / 2; ++l, ++n)
+                {
+                    constrain(index[i][j], node[2 * l + 1] - node[2 * l],
+                              mux[i][n] - node[2 * l]);
+                    node[l] = mux[i][n];
+                }
 
-            hash[i].generate_r1cs_constraints();
+            constrain(index[i][LOG_ARITY - 1], node[1] - node[0], prev[k] - node[0]);
         }
     }
 
-    void generate_r1cs_witness(size_t idx)
+    void witness_onehot(size_t i, const DigVar &prev, size_t rem)
     {
-        size_t rem = idx % ARITY;
-
         for (size_t j = 0; j < ARITY1; ++j)
-        {
-            val(active[0][j]) = rem == j;
-
-            if (rem == j)
-                for (size_t k = 0; k < DIGEST_VARS; ++k)
-                    val(children[0][j][k]) = val(trans[k]);
-            else
-                for (size_t k = 0; k < DIGEST_VARS; ++k)
-                    val(children[0][j][k]) = val(other[0][j][k]);
-        }
+            val(active[i][j]) = rem == j;
 
-        if (rem == ARITY1)
+        for (size_t j = 0; j < ARITY; ++j)
             for (size_t k = 0; k < DIGEST_VARS; ++k)
-                val(children[0][ARITY1][k]) = val(trans[k]);
-        else
-            for (size_t k = 0; k < DIGEST_VARS; ++k)
-                val(children[0][ARITY1][k]) = val(other[0][ARITY1][k]);
+                val(children[i][j][k]) = rem == j ? val(prev[k]) : val(other[i][j][k]);
+    }
 
-        hash[0].generate_r1cs_witness();
+    void witness_mux(size_t i, size_t rem)
+    {
+        for (size_t j = 0; j < LOG_ARITY; ++j)
+            val(index[i][j]) = (rem >> j) & 1;
 
-        idx /= ARITY;
-        for (size_t i = 1; i < HEIGHT1; ++i, idx /= ARITY)
+        for (size_t k = 0, n = 0; k < DIGEST_VARS; ++k)
         {
-            rem = idx % ARITY;
+            std::array<Field, ARITY> node;
 
-            for (size_t j = 0; j < ARITY1; ++j)
-            {
-                val(active[i][j]) = rem == j;
-
-                if (rem == j)
-                    for (size_t k = 0; k < DIGEST_VARS; ++k)
-                        val(children[i][j][k]) = val(inter[i - 1][k]);
-                else
-                    for (size_t k = 0; k < DIGEST_VARS; ++k)
-                        val(children[i][j][k]) = val(other[i][j][k]);
-            }
+            for (size_t j = 0; j < ARITY; ++j)
+                node[j] = val(other[i][j][k]);
 
-            if (rem == ARITY1)
-                for (size_t k = 0; k < DIGEST_VARS; ++k)
-                    val(children[i][ARITY1][k]) = val(inter[i - 1][k]);
-            else
-                for (size_t k = 0; k < DIGEST_VARS; ++k)
-                    val(children[i][ARITY1][k]) = val(other[i][ARITY1][k]);
-
-            hash[i].generate_r1cs_witness();
+            for (size_t j = 0, len = ARITY; len > 2; ++j, len >>= 1)
+                for (size_t l = 0; l < len / 2; ++l, ++n)
+                    node[l] = val(mux[i][n]) = node[2 * l + ((rem >> j) & 1)];
         }
     }
 };
+
+template<size_t height, typename GadHashT, MTreeSelector selector = MTreeSelector::ONEHOT>
+class MTreeGadget : public MTreeLevelsGadget<GadHashT, selector>
+{
+public:
+    using super = MTreeLevelsGadget<GadHashT, selector>;
+    using DigVar = typename super::DigVar;
+    using Level = typename super::Level;
+    using Protoboard = typename super::Protoboard;
+
+    static constexpr size_t HEIGHT = height;
+
+    static_assert(HEIGHT > 1, "MTreeGadget: the tree height must be at least 2");
+
+    // CIRCUIT COST
+    static constexpr size_t variables() { return super::variables(HEIGHT); }
+    static constexpr size_t constraints() { return super::constraints(HEIGHT); }
+    static constexpr size_t nonzero_terms() { return super::nonzero_terms(HEIGHT); }
+
+    MTreeGadget(Protoboard &pb, const DigVar &out, const DigVar &trans,
+                const std::vector<Level> &other, const std::string &ap) :
+        super{pb, out, trans, other, ap}
+    {
+        if (other.size() != HEIGHT - 1)
+            throw std::invalid_argument{"MTreeGadget: other must hold HEIGHT - 1 levels"};
+    }
+};
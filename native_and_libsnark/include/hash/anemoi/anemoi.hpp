@@ -1,6 +1,8 @@
 #pragma once
 
 #include "util/algebra.hpp"
+#include "util/small_matmul.hpp"
+#include "util/trace.hpp"
 
 template<typename FieldT = libff::Fr<libff::default_ec_pp>, size_t rate = 2, size_t capacity = 2,
          size_t rounds = 19>
@@ -19,18 +21,26 @@ public:
     static_assert(BRANCH_N % 2 == 0, "Anemoi: branch number (rate+capacity) must be even");
 
     static constexpr size_t ELL = BRANCH_N / 2;
+    // Independent states evaluated in lockstep by hash_field_lanes
+    static constexpr size_t LANES = 4;
 
     using Sponge = std::array<Field, BRANCH_N>;
     using State = std::array<Field, ELL>;
     using Constants = std::array<std::pair<Field, Field>, ROUNDS_N * ELL>;
     using Matrix = std::array<Field, ELL * ELL>;
+    // Per round, every Flystel gets x_1, y_1, t^2, t^4 and x_2 with t = x_1^(1/a)
+    using Trace = TraceSink<Field, ELL>;
 
     static inline const struct Init
     {
         Init() { libff::default_ec_pp::init_public_params(); }
     } init;
 
-    static inline const Field g{7};
+    static constexpr uint64_t G = 7;
+    // Matrix of the generic case (l > 4), 1, 2, ..., l^2 in row-major order
+    static constexpr std::array<uint64_t, ELL * ELL> MAT{constant_iota<ELL * ELL>(1)};
+
+    static inline const Field g{G};
     static inline const Field g_i{modular_inverse(g, Field{-1})};
     static inline const Field alpha{5};
     static inline const Field alpha_i{modular_inverse(alpha, Field{-1})};
@@ -117,6 +127,30 @@ public:
     static inline const Constants round_c{gen_constants()};
     static inline const Matrix mat{gen_matrix()};
 
+    // Matrix of one matmul(): mat, or mat * mat for l = 2 (see matmul)
+    static inline Matrix gen_layer_matrix()
+    {
+        if constexpr (ELL != 2)
+            return mat;
+
+        Matrix m{};
+
+        for (size_t i = 0; i < ELL; ++i)
+            for (size_t j = 0; j < ELL; ++j)
+                for (size_t k = 0; k < ELL; ++k)
+                    m[i * ELL + j] += mat[i * ELL + k] * mat[k * ELL + j];
+
+        return m;
+    }
+
+    // Built on first use, after mat
+    static const Matrix &layer_matrix()
+    {
+        static const Matrix m{gen_layer_matrix()};
+
+        return m;
+    }
+
     static void raise_alpha(Field &x)
     {
         Field t{x};
@@ -133,107 +167,169 @@ public:
         x ^= ai;
     }
 
+    // x[k] = x[k]^(1/a) for every k, in lockstep (see power_lanes)
+    template<size_t n>
+    static void raise_alpha_inv_lanes(std::array<Field, n> &x)
+    {
+        static const auto ai{alpha_i.as_bigint()};
+
+        power_lanes(x, ai);
+    }
+
     static void matmul(State &x)
     {
+        // The generator g is a small constant, so its products are addition chains and the whole
+        // layer stays unreduced (LazyField) until the outputs are written
         if constexpr (ELL == 1)
         {
             ;
         }
-        if constexpr (ELL == 2)
+        else if constexpr (ELL == 2)
         {
-            x[0] += g * x[1];
-            x[1] += g * x[0];
+            // M is applied twice: this layer has always run its closed form and then the generic
+            // product by mat, which is the same matrix, and the test vector was made that way
+            for (size_t r = 0; r < 2; ++r)
+            {
+                auto l{to_lazy(x)};
+
+                small_mul_add<G>(l[0], l[1]);
+                small_mul_add<G>(l[1], l[0]);
+                from_lazy(x, l);
+            }
         }
-        if constexpr (ELL == 3)
+        else if constexpr (ELL == 3)
         {
-            Field t{x[0] + g * x[2]};
-
-            x[2] += x[1];
-            x[2] += g * x[0];
-            x[0] = t;
-            x[0] += x[2];
-            x[1] += t;
+            auto l{to_lazy(x)};
+            LazyField<Field> t{x[0]};
+
+            small_mul_add<G>(t, x[2]);
+            l[2] += x[1];
+            small_mul_add<G>(l[2], x[0]);
+            l[0] = t;
+            l[0] += l[2];
+            l[1] += t;
+            from_lazy(x, l);
         }
         else if constexpr (ELL == 4)
         {
-            x[0] += x[1];
-            x[2] += x[3];
-            x[3] += g * x[0];
-            x[1] = g * (x[1] + x[2]);
-            x[0] += x[1];
-            x[2] += g * x[3];
-            x[1] += x[2];
-            x[3] += x[0];
+            auto l{to_lazy(x)};
+
+            l[0] += l[1];
+            l[2] += l[3];
+            small_mul_add<G>(l[3], l[0]);
+            l[1] += l[2];
+            small_mul<G>(l[1]);
+            l[0] += l[1];
+            small_mul_add<G>(l[2], l[3]);
+            l[1] += l[2];
+            l[3] += l[0];
+            from_lazy(x, l);
         }
         else
         {
-            State s{};
-            for (size_t i = 0; i < ELL; ++i)
-                for (size_t j = 0; j < ELL; ++j)
-                    s[i] += mat[i * ELL + j] * x[j];
-
-            x = s;
+            SmallMatmul<ELL, MAT>::apply(x);
         }
     }
 
     static void rho(State &x) { std::rotate(x.begin(), x.begin() + 1, x.end()); }
 
-    static void hash_field(Sponge &h)
+    // Round constants, linear layers and pseudo-Hadamard transform of round i
+    static void linear(State &x, State &y, size_t i)
     {
-        State x, y;
-        Field t;
-
-        for (size_t i = 0; i < ELL; ++i)
+        // ADD ROUND CONSTANTS
+        for (size_t j = 0; j < ELL; ++j)
         {
-            x[i] = h[i];
-            y[i] = h[ELL + i];
+            x[j] += round_c[i * ELL + j].first;
+            y[j] += round_c[i * ELL + j].second;
         }
 
-        for (size_t i = 0; i < ROUNDS_N; ++i)
+        // M_x MULTIPLICATION
+        matmul(x);
+        // RHO ROTATION
+        rho(y);
+        // M_y MULTIPLICATION
+        matmul(y);
+
+        // PSEUDO-HADAMARD
+        for (size_t j = 0; j < ELL; ++j)
         {
-            // ADD ROUND CONSTANTS
-            for (size_t j = 0; j < ELL; ++j)
-            {
-                x[j] += round_c[i * ELL + j].first;
-                y[j] += round_c[i * ELL + j].second;
-            }
+            x[j] += y[j];
+            y[j] += x[j];
+        }
+    }
 
-            // M_x MULTIPLICATION
-            matmul(x);
-            // RHO ROTATION
-            rho(y);
-            // M_y MULTIPLICATION
-            matmul(y);
+    /*
+    Flystel S-boxes of n states. All the columns share the exponent 1/a, so the n * ELL
+    exponentiations run as one, in lockstep (raise_alpha_inv_lanes), between the steps before and
+    after them. The trace is filled column by column, for a single state (n = 1).
+    */
+    template<size_t n>
+    static void flystel(std::array<State, n> &x, std::array<State, n> &y, Trace *trace = nullptr)
+    {
+        /*
+        Flystel performs the following computations:
+            1. x_1 = x_0 - (g(y_0 * y_0) + g_i)
+            2. y_1 = y_0 - x_1^(a_i)
+            3. x_2 = x_1 + g(y_1 * y_1)
+        */
+        std::array<Field, n * ELL> a;
+        Field t;
 
-            // PSEUDO-HADAMARD
+        for (size_t k = 0; k < n; ++k)
             for (size_t j = 0; j < ELL; ++j)
             {
-                x[j] += y[j];
-                y[j] += x[j];
+                t = y[k][j];
+                t *= t;
+                t *= g;
+                t += g_i;
+                x[k][j] -= t;
+                a[k * ELL + j] = x[k][j];
             }
 
-            // Flystel SBOX
-            /*
-            Flystel performs the following computations:
-                1. x_1 = x_0 - (g(y_0 * y_0) + g_i)
-                2. y_1 = y_0 - x_1^(a_i)
-                3. x_2 = x_1 + g(y_1 * y_1)
-            */
+        raise_alpha_inv_lanes(a);
+
+        for (size_t k = 0; k < n; ++k)
             for (size_t j = 0; j < ELL; ++j)
             {
-                t = y[j];
+                t = a[k * ELL + j];
+                y[k][j] -= t;
+
+                if (trace)
+                {
+                    trace->push(j, x[k][j]);
+                    trace->push(j, y[k][j]);
+                    t *= t;
+                    trace->push(j, t);
+                    t *= t;
+                    trace->push(j, t);
+                }
+
+                t = y[k][j];
                 t *= t;
                 t *= g;
-                t += g_i;
-                x[j] -= t;
-                t = x[j];
-                raise_alpha_inv(t);
-                y[j] -= t;
-                t = y[j];
-                t *= t;
-                t *= g;
-                x[j] += t;
+                x[k][j] += t;
+
+                if (trace)
+                    trace->push(j, x[k][j]);
             }
+    }
+
+    static void hash_field(Sponge &h, Trace *trace = nullptr)
+    {
+        std::array<State, 1> xs, ys;
+        State &x{xs[0]};
+        State &y{ys[0]};
+
+        for (size_t i = 0; i < ELL; ++i)
+        {
+            x[i] = h[i];
+            y[i] = h[ELL + i];
+        }
+
+        for (size_t i = 0; i < ROUNDS_N; ++i)
+        {
+            linear(x, y, i);
+            flystel(xs, ys, trace);
         }
 
         // Final matrix multiplication
@@ -248,6 +344,41 @@ public:
         }
     }
 
+    // hash_field of n independent states, with all their Flystel exponentiations in lockstep
+    template<size_t n = LANES>
+    static void hash_field_lanes(std::array<Sponge, n> &h)
+    {
+        std::array<State, n> x, y;
+
+        for (size_t k = 0; k < n; ++k)
+            for (size_t i = 0; i < ELL; ++i)
+            {
+                x[k][i] = h[k][i];
+                y[k][i] = h[k][ELL + i];
+            }
+
+        for (size_t i = 0; i < ROUNDS_N; ++i)
+        {
+            for (size_t k = 0; k < n; ++k)
+                linear(x[k], y[k], i);
+
+            flystel(x, y);
+        }
+
+        for (size_t k = 0; k < n; ++k)
+        {
+            matmul(x[k]);
+            rho(y[k]);
+            matmul(y[k]);
+
+            for (size_t i = 0; i < ELL; ++i)
+            {
+                h[k][i] = x[k][i];
+                h[k][ELL + i] = y[k][i];
+            }
+        }
+    }
+
     static void hash_oneblock(uint8_t *digest, const void *message)
     {
         Sponge h{};
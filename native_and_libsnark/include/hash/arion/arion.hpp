@@ -1,7 +1,10 @@
 #pragma once
 
 #include "util/algebra.hpp"
+#include "util/const_math.hpp"
+#include "util/small_matmul.hpp"
 #include "util/string_utils.hpp"
+#include "util/trace.hpp"
 
 template<typename FieldT = libff::Fr<libff::default_ec_pp>, size_t rate = 2, size_t capacity = 1,
          size_t rounds = 9>
@@ -17,9 +20,15 @@ public:
     static constexpr size_t DIGEST_SIZE = field_size<Field>();
     static constexpr size_t BLOCK_SIZE = DIGEST_SIZE * RATE;
     static constexpr uint64_t D2 = 257;
+    static constexpr size_t D2_BITS = ilog2(D2) + 1; // assuming D2 = 2^k + 1
+    // Independent states evaluated in lockstep by the *_lanes functions
+    static constexpr size_t LANES = 4;
 
     using Sponge = std::array<Field, BRANCH_N>;
     using Constants = std::array<Field, ROUNDS_N * BRANCH_N>;
+    // Per round, branch n-1 gets y^(2^k), ..., y^2, y with y = x^e, every other branch gets
+    // x^2, x^4, x^5, sigma^2 and its output
+    using Trace = TraceSink<Field, BRANCH_N>;
 
     static inline const struct Init
     {
@@ -42,11 +51,15 @@ public:
         return c;
     }
 
+    // First row of the circulant matrix, circ(1, 2, ..., t)
+    static constexpr std::array<uint64_t, BRANCH_N> CIRC_MAT{constant_iota<BRANCH_N>(1)};
+
     static Sponge gen_circmat()
     {
         Sponge s;
 
-        std::iota(s.begin(), s.end(), Field{1});
+        for (size_t i = 0; i < BRANCH_N; ++i)
+            s[i] = Field(CIRC_MAT[i]);
 
         return s;
     }
@@ -64,6 +77,21 @@ public:
         x *= t;
     }
 
+    static void fifth(Field &x, Trace *trace, size_t k)
+    {
+        if (!trace)
+            return fifth(x);
+
+        Field t{x};
+
+        x *= x;
+        trace->push(k, x);
+        x *= x;
+        trace->push(k, x);
+        x *= t;
+        trace->push(k, x);
+    }
+
     static void pow_e(Field &x)
     {
         static const auto eb{e.as_bigint()};
@@ -71,12 +99,21 @@ public:
         x ^= eb;
     }
 
+    // x[k] = x[k]^e for every k, in lockstep (see power_lanes)
+    template<size_t n>
+    static void pow_e_lanes(std::array<Field, n> &x)
+    {
+        static const auto eb{e.as_bigint()};
+
+        power_lanes(x, eb);
+    }
+
     static void circular(Sponge &x)
     {
         if constexpr (BRANCH_N == 3)
         {
             // Explicit optimized steps for 3x3 circular matrix (it's 2.5x faster)
-            Sponge s;
+            std::array<LazyField<Field>, BRANCH_N> s;
 
             s[0] = x[0];
             s[0] += x[1];
@@ -90,50 +127,70 @@ public:
             s[1] += x[0];
             s[0] += x[1];
             s[0] += x[2];
-            x = s;
+            from_lazy(x, s);
         }
         else
         {
-            Field sigma{x[0]};
+            // Sums stay unreduced until each output is written, products by the (small) matrix
+            // constants are unrolled into addition chains
+            LazyField<Field> sigma{x[0]};
             Field old{x[0]};
 
             for (size_t i = 1; i < BRANCH_N; ++i)
                 sigma += x[i];
 
-            x[0] = sigma;
-            for (size_t i = 1; i < BRANCH_N; ++i)
-                x[0] += circ_mat[i - 1] * x[i];
+            Field s{sigma.reduce()};
+            LazyField<Field> y{sigma};
+
+            static_for<BRANCH_N - 1>([&](auto i) { small_mul_add<CIRC_MAT[i]>(y, x[i + 1]); });
+            x[0] = y.reduce();
 
             for (size_t i = 1; i < BRANCH_N; ++i)
             {
-                std::swap(x[i], old);
-                x[i] *= circ_mat[BRANCH_N - 1];
-                x[i] += x[i - 1];
-                x[i] -= sigma;
+                LazyField<Field> z{old};
+
+                old = x[i];
+                small_mul<CIRC_MAT[BRANCH_N - 1]>(z);
+                z += y;
+                z -= s;
+                y = z;
+                x[i] = y.reduce();
             }
         }
     }
 
-    static void gtds(Sponge &x)
+    static void gtds(Sponge &x, Trace *trace = nullptr)
     {
         Sponge f;
         Field t;
-        Field sigma;
+        Field sigma{};
 
         // Base case, f(x) = x[n]^e = x[n]^(1/d)
         f[BRANCH_N - 1] = x[BRANCH_N - 1];
         pow_e(f[BRANCH_N - 1]);
 
+        if (trace)
+        {
+            // The powers of y are recorded from the highest one down
+            Field *p = trace->take(BRANCH_N - 1, D2_BITS);
+
+            p[D2_BITS - 1] = f[BRANCH_N - 1];
+            for (size_t k = D2_BITS - 1; k > 0; --k)
+                p[k - 1] = p[k] * p[k];
+        }
+
         // Recursive case: f(x) = x[i]^d * g(x) + h(x)
         for (size_t i = BRANCH_N - 2; i != (size_t)~0; --i)
         {
             // f(x[i]) = x[i]^d
             f[i] = x[i];
-            fifth(f[i]);
-            // sigma = sum_{j=i+1}^{BRANCH_N}{x[j] + f[j]}
-            sigma = x[i + 1] + f[i + 1];
-            for (size_t j = i + 2; j < BRANCH_N; ++j)
-                sigma += x[j] + f[j];
+            fifth(f[i], trace, i);
+            // sigma = sum_{j=i+1}^{BRANCH_N}{x[j] + f[j]}: the sum of branch i + 1 plus one term
+            sigma += x[i + 1];
+            sigma += f[i + 1];
+
+            if (trace)
+                trace->push(i, sigma * sigma);
 
             // t = g(x) = sigma^2 + alpha1*sigma + alpha2
             t = sigma;
@@ -147,25 +204,103 @@ public:
             t += beta1;
             t *= sigma;
             f[i] += t;
+
+            if (trace)
+                trace->push(i, f[i]);
+        }
+
+        x = f;
+    }
+
+    /*
+    GTDS of n independent states in lockstep: the exponentiations of all the last branches run
+    together, then every branch i is computed for all the states before branch i - 1. sigma is
+    kept as a running sum, sigma_i = sigma_{i+1} + x[i+1] + f[i+1], instead of being summed again
+    for every branch.
+    */
+    template<size_t n>
+    static void gtds_lanes(std::array<Sponge, n> &x)
+    {
+        std::array<Sponge, n> f;
+        std::array<Field, n> y;
+        std::array<Field, n> sigma{};
+        Field t;
+
+        // Base case, f(x) = x[n]^e, and x[i]^d for every other branch (independent of it)
+        for (size_t k = 0; k < n; ++k)
+            y[k] = x[k][BRANCH_N - 1];
+
+        pow_e_lanes(y);
+
+        for (size_t k = 0; k < n; ++k)
+        {
+            f[k][BRANCH_N - 1] = y[k];
+
+            for (size_t i = 0; i < BRANCH_N - 1; ++i)
+            {
+                f[k][i] = x[k][i];
+                fifth(f[k][i]);
+            }
         }
 
+        // Recursive case: f(x) = x[i]^d * g(x) + h(x)
+        for (size_t i = BRANCH_N - 2; i != (size_t)~0; --i)
+            for (size_t k = 0; k < n; ++k)
+            {
+                sigma[k] += x[k][i + 1];
+                sigma[k] += f[k][i + 1];
+
+                // t = g(x) = sigma^2 + alpha1*sigma + alpha2
+                t = sigma[k];
+                t += alpha.first;
+                t *= sigma[k];
+                t += alpha.second;
+                f[k][i] *= t;
+
+                // t = h(x) = sigma^2 + beta1*sigma
+                t = sigma[k];
+                t += beta1;
+                t *= sigma[k];
+                f[k][i] += t;
+            }
+
         x = f;
     }
 
-    static void hash_field(Sponge &h)
+    static void hash_field(Sponge &h, Trace *trace = nullptr)
     {
         // Round 0, we assume key = 0, so no key addition is ever needed
         circular(h);
 
         for (size_t i = 0; i < ROUNDS_N; ++i)
         {
-            gtds(h);
+            gtds(h, trace);
             circular(h);
             for (size_t j = 0; j < BRANCH_N; ++j)
                 h[j] += round_c[i * BRANCH_N + j];
         }
     }
 
+    // hash_field of n independent states, with the GTDS evaluated in lockstep
+    template<size_t n = LANES>
+    static void hash_field_lanes(std::array<Sponge, n> &h)
+    {
+        for (auto &&x : h)
+            circular(x);
+
+        for (size_t i = 0; i < ROUNDS_N; ++i)
+        {
+            gtds_lanes(h);
+
+            for (auto &&x : h)
+            {
+                circular(x);
+                for (size_t j = 0; j < BRANCH_N; ++j)
+                    x[j] += round_c[i * BRANCH_N + j];
+            }
+        }
+    }
+
     static void hash_oneblock(uint8_t *digest, const void *message)
     {
         Sponge h{};
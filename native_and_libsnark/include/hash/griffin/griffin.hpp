@@ -1,6 +1,8 @@
 #pragma once
 
 #include "util/algebra.hpp"
+#include "util/small_matmul.hpp"
+#include "util/trace.hpp"
 
 template<typename FieldT = libff::Fr<libff::default_ec_pp>, size_t rate = 2, size_t capacity = 1, size_t rounds = 12>
 class Griffin
@@ -15,27 +17,41 @@ public:
     static constexpr size_t BLOCK_SIZE = DIGEST_SIZE * RATE;
     static constexpr size_t BRANCH_N = RATE + CAPACITY;
     static constexpr size_t CIRC_N = std::min(BRANCH_N, (size_t)8);
+    // Independent states evaluated in lockstep by the *_lanes functions
+    static constexpr size_t LANES = 4;
 
     using Sponge = std::array<Field, BRANCH_N>;
     using CircMat = std::array<Field, CIRC_N>;
+    using CircConstants = std::array<uint64_t, CIRC_N>;
+    // Per round, branch 0 gets y^4, y^2, y with y = x^e, branch 1 gets x^2, x^4, x^5, every other
+    // branch gets L^2 + a1*L + a2 and its output
+    using Trace = TraceSink<Field, BRANCH_N>;
 
     static inline const struct Init
     {
         Init() { libff::default_ec_pp::init_public_params(); }
     } init;
 
+    static_assert(BRANCH_N == 3 || BRANCH_N % 4 == 0, "Invalid branch size");
+
+    static constexpr CircConstants CIRC_MAT{[]
+                                            {
+                                                if constexpr (BRANCH_N == 3)
+                                                    return CircConstants{2, 1, 1};
+                                                else if constexpr (BRANCH_N == 4)
+                                                    return CircConstants{3, 2, 1, 1};
+                                                else
+                                                    return CircConstants{6, 4, 2, 2, 3, 2, 1, 1};
+                                            }()};
+
     static inline CircMat circular_matrix()
     {
-        if constexpr (BRANCH_N == 3)
-            return CircMat{2, 1, 1};
-        else if constexpr (BRANCH_N == 4)
-            return CircMat{3, 2, 1, 1};
-        else
-        {
-            static_assert(BRANCH_N % 4 == 0, "Invalid branch size");
+        CircMat m;
 
-            return CircMat{6, 4, 2, 2, 3, 2, 1, 1};
-        }
+        for (size_t i = 0; i < CIRC_N; ++i)
+            m[i] = Field(CIRC_MAT[i]);
+
+        return m;
     }
 
     static inline const Field d{5};
@@ -55,105 +71,222 @@ public:
         x *= t;
     }
 
+    static void fifth(Field &x, Trace *trace, size_t k)
+    {
+        if (!trace)
+            return fifth(x);
+
+        Field t{x};
+
+        x *= x;
+        trace->push(k, x);
+        x *= x;
+        trace->push(k, x);
+        x *= t;
+        trace->push(k, x);
+    }
+
     static void fifth_inv(Field &x)
     {
         static const auto eb = e.as_bigint();
         x ^= eb;
     }
 
+    // x[k] = x[k]^e for every k, in lockstep (see power_lanes)
+    template<size_t n>
+    static void fifth_inv_lanes(std::array<Field, n> &x)
+    {
+        static const auto eb{e.as_bigint()};
+
+        power_lanes(x, eb);
+    }
+
     static void circular(Sponge &x)
     {
+        // Sums stay unreduced (LazyField) until the outputs are written, x keeps the inputs
         if constexpr (BRANCH_N == 3)
         {
-            Field old{x[0]};
-
-            x[0] += x[1];
-            x[0] += x[2];
-            x[1] += x[0];
-            x[2] += x[0];
-            x[0] += old;
+            auto l{to_lazy(x)};
+
+            l[0] += l[1];
+            l[0] += l[2];
+            l[1] += l[0];
+            l[2] += l[0];
+            l[0] += x[0];
+            from_lazy(x, l);
         }
         else if constexpr (BRANCH_N == 4)
         {
-            Field old[2]{x[0], x[1]};
-
-            x[0] += x[1];
-            x[0] += x[2];
-            x[0] += x[3];
-
-            x[1] += x[1];
-            x[1] += x[2];
-            x[1] += x[0];
-
-            x[2] += x[2];
-            x[2] += x[3];
-            x[2] += x[0];
-
-            x[3] += x[3];
-            x[3] += x[0];
-            x[3] += old[0];
-            x[0] += old[0];
-            x[0] += old[0];
-            x[0] += old[1];
+            auto l{to_lazy(x)};
+
+            l[0] += l[1];
+            l[0] += l[2];
+            l[0] += l[3];
+
+            l[1] += l[1];
+            l[1] += l[2];
+            l[1] += l[0];
+
+            l[2] += l[2];
+            l[2] += l[3];
+            l[2] += l[0];
+
+            l[3] += l[3];
+            l[3] += l[0];
+            l[3] += x[0];
+            l[0] += x[0];
+            l[0] += x[0];
+            l[0] += x[1];
+            from_lazy(x, l);
         }
         else
         {
+            // In blocks of 4 branches, every row of block i is CIRC_MAT[0..3] . x_i plus
+            // CIRC_MAT[4..7] . x_j for every other block j, so the 4 outputs of a block are equal.
+            // The first half of the constants is twice the second one, hence with
+            // v_j = CIRC_MAT[4..7] . x_j every output of block i is v_i + sum_j v_j
+            static_assert(CIRC_MAT[0] == 2 * CIRC_MAT[4] && CIRC_MAT[1] == 2 * CIRC_MAT[5] &&
+                              CIRC_MAT[2] == 2 * CIRC_MAT[6] && CIRC_MAT[3] == 2 * CIRC_MAT[7],
+                          "Unexpected wide circulant");
+
             static constexpr size_t BRANCH_N4 = BRANCH_N / 4;
 
-            Sponge sum{};
+            std::array<LazyField<Field>, BRANCH_N4> v{};
+            LazyField<Field> u;
+
+            static_for<BRANCH_N4>(
+                [&](auto j)
+                {
+                    static_for<4>([&](auto l)
+                                  { small_mul_add<CIRC_MAT[4 + l]>(v[j], x[4 * j + l]); });
+                    u += v[j];
+                });
 
-            for (size_t i = 0; i < BRANCH_N4; ++i)
-                for (size_t j = 0; j < BRANCH_N4; ++j)
-                    for (size_t k = 0, off = 4 * (i != j); k < 4; ++k)
-                        for (size_t l = 0; l < 4; ++l)
-                            sum[4 * i + k] += circ_mat[off + l] * x[4 * j + l];
+            for (size_t j = 0; j < BRANCH_N4; ++j)
+            {
+                Field y{(u + v[j]).reduce()};
 
-            x = sum;
+                for (size_t l = 0; l < 4; ++l)
+                    x[4 * j + l] = y;
+            }
         }
     }
 
-    static void sbox(Sponge &x)
+    static void sbox(Sponge &x, Trace *trace = nullptr)
     {
         // Base case, y[0] = x[0]^e = x[0]^(1/d)
         fifth_inv(x[0]);
 
+        if (trace)
+        {
+            Field y2{x[0] * x[0]};
+
+            trace->push(0, y2 * y2);
+            trace->push(0, y2);
+            trace->push(0, x[0]);
+        }
+
         // Base case, y[1] = x[1]^d
-        fifth(x[1]);
+        fifth(x[1], trace, 1);
 
         // Recursive case y[i] = x[i] * (L(y0,y1,old)^2 + a1*L(y0,y1,old) + a2)
         // <==> y[i] = x[i] * (L(y0,y1,old) * (L(y0,y1,old) + a1) + a2)
-        // L(y1, y2, old) = gamma*y1 + y2 + old
+        // L(y1, y2, old) = gamma*y1 + y2 + old, the first two terms are the same for every branch
+        const Field base{gamma * x[0] + x[1]};
         Field l;
         Field old{}; // old = 0 at the beginning
 
         for (size_t i = 2; i < BRANCH_N; ++i)
         {
-            l = gamma;
-            l *= x[0];
-            l += x[1];
+            l = base;
             l += old;
             old = x[i];
             x[i] = l;
             x[i] += alpha.first;
             x[i] *= l;
             x[i] += alpha.second;
+
+            if (trace)
+                trace->push(i, x[i]);
+
             x[i] *= old;
+
+            if (trace)
+                trace->push(i, x[i]);
+        }
+    }
+
+    /*
+    sbox() for n independent states: the exponentiations x[0]^e of all the states are done in
+    lockstep, then every branch is computed for all the states before the next one
+    */
+    template<size_t n>
+    static void sbox_lanes(std::array<Sponge, n> &x)
+    {
+        std::array<Field, n> y;
+        std::array<Field, n> base;
+        std::array<Field, n> old{};
+        Field l;
+
+        for (size_t k = 0; k < n; ++k)
+            y[k] = x[k][0];
+
+        fifth_inv_lanes(y);
+
+        for (size_t k = 0; k < n; ++k)
+        {
+            x[k][0] = y[k];
+            fifth(x[k][1]);
+            base[k] = gamma * x[k][0] + x[k][1];
         }
+
+        for (size_t i = 2; i < BRANCH_N; ++i)
+            for (size_t k = 0; k < n; ++k)
+            {
+                l = base[k];
+                l += old[k];
+                old[k] = x[k][i];
+                x[k][i] = l;
+                x[k][i] += alpha.first;
+                x[k][i] *= l;
+                x[k][i] += alpha.second;
+                x[k][i] *= old[k];
+            }
     }
 
-    static void hash_field(Sponge &h)
+    static void hash_field(Sponge &h, Trace *trace = nullptr)
     {
         // Round 0, we assume key = 0, so no key addition is ever needed
         circular(h);
         for (size_t i = 0; i < ROUNDS_N; ++i)
         {
-            sbox(h);
+            sbox(h, trace);
             circular(h);
             for (size_t j = 0; j < BRANCH_N; ++j)
                 h[j] += round_c[i * BRANCH_N + j];
         }
     }
 
+    // hash_field of n independent states, with the S-box evaluated in lockstep
+    template<size_t n = LANES>
+    static void hash_field_lanes(std::array<Sponge, n> &h)
+    {
+        for (auto &&x : h)
+            circular(x);
+
+        for (size_t i = 0; i < ROUNDS_N; ++i)
+        {
+            sbox_lanes(h);
+
+            for (auto &&x : h)
+            {
+                circular(x);
+                for (size_t j = 0; j < BRANCH_N; ++j)
+                    x[j] += round_c[i * BRANCH_N + j];
+            }
+        }
+    }
+
     static void hash_oneblock(uint8_t *digest, const void *message)
     {
         Sponge h{};
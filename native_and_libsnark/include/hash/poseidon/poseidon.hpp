@@ -1,6 +1,7 @@
 #pragma once
 
 #include "util/algebra.hpp"
+#include "util/trace.hpp"
 
 template<typename FieldT = libff::Fr<libff::default_ec_pp>, size_t rate = 2, size_t capacity = 1,
          size_t rounds_f = 4, size_t rounds_p = 57>
@@ -23,6 +24,8 @@ public:
     using Sponge = std::array<Field, BRANCH_N>;
     using Matrix = std::array<Field, BRANCH_N * BRANCH_N>;
     using Constants = std::array<Field, ROUNDS_N * BRANCH_N>;
+    // x^2, x^4, x^5 of every S-box, per branch
+    using Trace = TraceSink<Field, BRANCH_N>;
 
     static inline const struct Init
     {
@@ -62,6 +65,21 @@ public:
         x *= t;
     }
 
+    static void fifth(Field &x, Trace *trace, size_t k)
+    {
+        if (!trace)
+            return fifth(x);
+
+        Field t{x};
+
+        x *= x;
+        trace->push(k, x);
+        x *= x;
+        trace->push(k, x);
+        x *= t;
+        trace->push(k, x);
+    }
+
     static void matmul(Sponge &arr)
     {
         Sponge sum{};
@@ -73,7 +91,7 @@ public:
         arr = sum;
     }
 
-    static Field hash_field(Sponge &h)
+    static Field hash_field(Sponge &h, Trace *trace = nullptr)
     {
         // INITIAL FULL LAYERS
         for (size_t i = 0; i < ROUNDS_f_N; ++i)
@@ -82,7 +100,7 @@ public:
                 h[j] += round_c[i * BRANCH_N + j];
 
             for (size_t j = 0; j < BRANCH_N; ++j)
-                fifth(h[j]);
+                fifth(h[j], trace, j);
 
             matmul(h);
         }
@@ -94,7 +112,7 @@ public:
             for (size_t j = 0; j < BRANCH_N; ++j)
                 h[j] += round_c[(ROUNDS_f_N + i) * BRANCH_N + j];
 
-            fifth(h[0]);
+            fifth(h[0], trace, 0);
             matmul(h);
         }
 
@@ -105,7 +123,7 @@ public:
                 h[j] += round_c[(ROUNDS_f_N + ROUNDS_P_N + i) * BRANCH_N + j];
 
             for (size_t j = 0; j < BRANCH_N; ++j)
-                fifth(h[j]);
+                fifth(h[j], trace, j);
 
             matmul(h);
         }
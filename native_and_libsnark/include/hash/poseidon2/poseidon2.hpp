@@ -1,6 +1,7 @@
 #pragma once
 
 #include "util/algebra.hpp"
+#include "util/small_matmul.hpp"
 #include "util/string_utils.hpp"
 
 
@@ -51,11 +52,15 @@ public:
                                                      return c;
                                                  }()};
 
+    // Diagonal of the internal matrix (minus the all-ones matrix), 1, 2, ..., t
+    static constexpr std::array<uint64_t, BRANCH_N> INT_MAT{constant_iota<BRANCH_N>(1)};
+
     static inline const IntMatrix int_mat{[]
                                           {
                                               IntMatrix m;
 
-                                              std::iota(m.begin(), m.end(), Field{1});
+                                              for (size_t i = 0; i < BRANCH_N; ++i)
+                                                  m[i] = Field(INT_MAT[i]);
 
                                               return m;
                                           }()};
@@ -69,6 +74,7 @@ public:
         x *= t;
     }
 
+    // Linear layers accumulate in LazyField and reduce every output once
     static void ext_matmul(Block &x)
     {
         if constexpr (BRANCH_N == 1)
@@ -77,53 +83,63 @@ public:
         if constexpr (BRANCH_N == 2)
         {
             // M_E = [2, 1; 3, 1]
-            Field s = x[0] + x[1];
-
-            x[0] += s;
-            x[1] += x[1];
-            x[1] += s;
+            LazyField<Field> s{x[0]};
+            auto l{to_lazy(x)};
+
+            s += x[1];
+            l[0] += s;
+            l[1] += l[1];
+            l[1] += s;
+            from_lazy(x, l);
         }
         else if constexpr (BRANCH_N == 3)
         {
             // M_E = [2, 1, 1; 1, 3, 1; 1, 1, 5]
-            Field s = x[0] + x[1] + x[2];
-
-            x[0] += s;
-            x[1] += x[1];
-            x[1] += s;
-            x[2] += x[2];
-            x[2] += x[2];
-            x[2] += s;
+            LazyField<Field> s{x[0]};
+            auto l{to_lazy(x)};
+
+            s += x[1];
+            s += x[2];
+            l[0] += s;
+            l[1] += l[1];
+            l[1] += s;
+            l[2] += l[2];
+            l[2] += l[2];
+            l[2] += s;
+            from_lazy(x, l);
         }
         else
         {
-            Block t;
+            std::array<LazyField<Field>, BRANCH_N> y;
+            std::array<LazyField<Field>, 4> t;
 
             for (size_t i = 0; i < BRANCH_N; i += 4)
             {
-                t[0] = x[i + 0] + x[i + 1];
-                t[1] = x[i + 2] + x[i + 3];
-                t[2] = x[i + 1] + x[i + 1] + t[1];
-                t[3] = x[i + 3] + x[i + 3] + t[0];
-
-                x[i + 3] = t[1] + t[1] + t[1] + t[1] + t[3];
-                x[i + 1] = t[0] + t[0] + t[0] + t[0] + t[2];
-                x[i + 0] = t[3] + x[i + 1];
-                x[i + 2] = t[2] + x[i + 3];
+                t[0] = x[i + 0];
+                t[0] += x[i + 1];
+                t[1] = x[i + 2];
+                t[1] += x[i + 3];
+                t[2] = t[1] + x[i + 1] + x[i + 1];
+                t[3] = t[0] + x[i + 3] + x[i + 3];
+
+                y[i + 3] = t[1] + t[1] + t[1] + t[1] + t[3];
+                y[i + 1] = t[0] + t[0] + t[0] + t[0] + t[2];
+                y[i + 0] = t[3] + y[i + 1];
+                y[i + 2] = t[2] + y[i + 3];
             }
 
             for (size_t i = 0; i < BRANCH_N; ++i)
             {
-                t[i] = x[i] + x[i];
+                LazyField<Field> s{y[i] + y[i]};
 
                 for (size_t j = i & 3; j < i; j += 4)
-                    t[i] += x[j];
+                    s += y[j];
 
                 for (size_t j = i + 4; j < BRANCH_N; j += 4)
-                    t[i] += x[j];
-            }
+                    s += y[j];
 
-            x = t;
+                x[i] = s.reduce();
+            }
         }
     }
 
@@ -133,16 +149,21 @@ public:
             ext_matmul(x);
         else
         {
-            Field s{0ULL};
+            // Diagonal entries 1, ..., t of int_mat are unrolled into addition chains
+            LazyField<Field> s;
 
             for (size_t i = 0; i < BRANCH_N; ++i)
                 s += x[i];
 
-            for (size_t i = 0; i < BRANCH_N; ++i)
-            {
-                x[i] *= int_mat[i];
-                x[i] += s;
-            }
+            static_for<BRANCH_N>(
+                [&](auto i)
+                {
+                    LazyField<Field> y{x[i]};
+
+                    small_mul<INT_MAT[i]>(y);
+                    y += s;
+                    x[i] = y.reduce();
+                });
         }
     }
 
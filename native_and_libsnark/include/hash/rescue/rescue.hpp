@@ -1,6 +1,8 @@
 #pragma once
 
 #include "util/algebra.hpp"
+#include "util/small_matmul.hpp"
+#include "util/trace.hpp"
 
 template<typename FieldT = libff::Fr<libff::default_ec_pp>, size_t rate = 2, size_t capacity = 2,
          size_t rounds = 19>
@@ -15,10 +17,14 @@ public:
     static constexpr size_t DIGEST_SIZE = field_size<Field>();
     static constexpr size_t BLOCK_SIZE = DIGEST_SIZE * RATE;
     static constexpr size_t BRANCH_N = RATE + CAPACITY;
+    // Independent states evaluated in lockstep by hash_field_lanes
+    static constexpr size_t LANES = 4;
 
     using Sponge = std::array<Field, BRANCH_N>;
     using Constants = std::array<Field, ROUNDS_N * 2 * BRANCH_N>;
     using Matrix = std::array<Field, BRANCH_N * BRANCH_N>;
+    // Per round, every branch gets x^2, x^4, x^5 and then y, y^2, y^4 with y = x^(1/a)
+    using Trace = TraceSink<Field, BRANCH_N>;
 
     static inline const struct Init
     {
@@ -37,11 +43,16 @@ public:
         return c;
     }
 
+    // MDS matrix, 1, 2, ..., t^2 in row-major order
+    static constexpr std::array<uint64_t, BRANCH_N * BRANCH_N> MAT{
+        constant_iota<BRANCH_N * BRANCH_N>(1)};
+
     static inline Matrix gen_matrix()
     {
         Matrix m;
 
-        std::iota(m.begin(), m.end(), Field{1});
+        for (size_t i = 0; i < m.size(); ++i)
+            m[i] = Field(MAT[i]);
 
         return m;
     }
@@ -58,6 +69,21 @@ public:
         x *= t;
     }
 
+    static void raise_alpha(Field &x, Trace *trace, size_t k)
+    {
+        if (!trace)
+            return raise_alpha(x);
+
+        Field t{x};
+
+        x *= x;
+        trace->push(k, x);
+        x *= x;
+        trace->push(k, x);
+        x *= t;
+        trace->push(k, x);
+    }
+
     static void raise_alpha_inv(Field &x)
     {
         static const auto ai = alpha_i.as_bigint();
@@ -65,23 +91,55 @@ public:
         x ^= ai;
     }
 
+    // Records y, y^2, y^4 for an output y of the inverse S-box
+    static void trace_alpha_inv(const Field &y, Trace *trace, size_t k)
+    {
+        Field y2{y * y};
+
+        trace->push(k, y);
+        trace->push(k, y2);
+        trace->push(k, y2 * y2);
+    }
+
+    // x[k] = x[k]^(1/a) for every k, in lockstep (see power_lanes)
+    template<size_t n>
+    static void raise_alpha_inv_lanes(std::array<Field, n> &x)
+    {
+        static const auto ai{alpha_i.as_bigint()};
+
+        power_lanes(x, ai);
+    }
+
     static void matmul(Sponge &x)
     {
-        Sponge s{};
-        for (size_t i = 0; i < BRANCH_N; ++i)
-            for (size_t j = 0; j < BRANCH_N; ++j)
-                s[i] += mat[i * BRANCH_N + j] * x[j];
+        // Row i of MAT is t * i * (1, ..., 1) + (1, 2, ..., t), so with S = sum_j x[j] and
+        // W = sum_j (j + 1) x[j] the outputs are W, W + tS, W + 2tS, ...: W is the sum of the
+        // suffix sums of x, and the whole layer takes O(t) unreduced additions
+        LazyField<Field> s;
+        LazyField<Field> w;
 
-        x = s;
+        for (size_t j = BRANCH_N; j-- > 0;)
+        {
+            s += x[j];
+            w += s;
+        }
+
+        small_mul<BRANCH_N>(s);
+
+        for (size_t i = 0; i < BRANCH_N; ++i)
+        {
+            x[i] = w.reduce();
+            w += s;
+        }
     }
 
-    static void hash_field(Sponge &h)
+    static void hash_field(Sponge &h, Trace *trace = nullptr)
     {
         for (size_t i = 0; i < ROUNDS_N; ++i)
         {
             // Direct SBOX
             for (size_t j = 0; j < BRANCH_N; ++j)
-                raise_alpha(h[j]);
+                raise_alpha(h[j], trace, j);
 
             // MDS
             matmul(h);
@@ -90,9 +148,12 @@ public:
             for (size_t j = 0; j < BRANCH_N; ++j)
                 h[j] += round_c[i * 2 * BRANCH_N + j];
 
-            // Inverse SBOX
-            for (size_t j = 0; j < BRANCH_N; ++j)
-                raise_alpha_inv(h[j]);
+            // Inverse SBOX, the branches in lockstep
+            raise_alpha_inv_lanes(h);
+
+            if (trace)
+                for (size_t j = 0; j < BRANCH_N; ++j)
+                    trace_alpha_inv(h[j], trace, j);
 
             // Second MDS
             matmul(h);
@@ -103,6 +164,43 @@ public:
         }
     }
 
+    // hash_field of n independent states, with all their inverse S-boxes in lockstep
+    template<size_t n = LANES>
+    static void hash_field_lanes(std::array<Sponge, n> &h)
+    {
+        std::array<Field, n * BRANCH_N> y;
+
+        for (size_t i = 0; i < ROUNDS_N; ++i)
+        {
+            for (auto &&x : h)
+            {
+                for (size_t j = 0; j < BRANCH_N; ++j)
+                    raise_alpha(x[j]);
+
+                matmul(x);
+
+                for (size_t j = 0; j < BRANCH_N; ++j)
+                    x[j] += round_c[i * 2 * BRANCH_N + j];
+            }
+
+            for (size_t k = 0; k < n; ++k)
+                std::copy(h[k].begin(), h[k].end(), y.begin() + k * BRANCH_N);
+
+            raise_alpha_inv_lanes(y);
+
+            for (size_t k = 0; k < n; ++k)
+                std::copy(y.begin() + k * BRANCH_N, y.begin() + (k + 1) * BRANCH_N, h[k].begin());
+
+            for (auto &&x : h)
+            {
+                matmul(x);
+
+                for (size_t j = 0; j < BRANCH_N; ++j)
+                    x[j] += round_c[BRANCH_N + i * 2 * BRANCH_N + j];
+            }
+        }
+    }
+
     static void hash_oneblock(uint8_t *digest, const void *message)
     {
         Sponge h{};
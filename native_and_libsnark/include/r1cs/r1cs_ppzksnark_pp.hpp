@@ -1,6 +1,20 @@
 #pragma once
 
+#include "util/hash_traits.hpp"
+#include "util/mmap_stream.hpp"
+
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <libff/common/profiling.hpp>
 #include <libsnark/zk_proof_systems/ppzksnark/r1cs_ppzksnark/r1cs_ppzksnark.hpp>
+#include <omp.h>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
 
 template<typename ppT>
 class r1cs_ppzksnark_keypair
@@ -29,4 +43,240 @@ public:
 
     r1cs_ppzksnark_keypair<ppT> &operator=(const r1cs_ppzksnark_keypair<ppT> &other) = default;
     r1cs_ppzksnark_keypair<ppT> &operator=(r1cs_ppzksnark_keypair<ppT> &&other) = default;
+
+    /*
+    On-disk layout:
+    - MAGIC, followed by the shape key the file was generated for
+    - the verification key (small, read first so a mismatch fails early)
+    - the proving key
+    Both keys use libsnark's own serialization, so the format follows libff's BINARY_OUTPUT.
+    */
+    static constexpr uint64_t MAGIC = 0x31305041454b5a50ULL; // "PZKEAP01"
+
+    bool save(const std::string &path, uint64_t shape) const
+    {
+        std::filesystem::path p{path};
+        std::error_code ec;
+
+        // the error_code overloads: a cache that cannot be written is not an error for the caller
+        if (p.has_parent_path())
+            std::filesystem::create_directories(p.parent_path(), ec);
+
+        if (ec)
+            return false;
+
+        // write to a temporary, then rename: concurrent runs never observe a partial key
+        std::string tmp = path + ".tmp";
+        std::ofstream out{tmp, std::ios::binary | std::ios::trunc};
+
+        if (!out)
+            return false;
+
+        out.write((const char *)&MAGIC, sizeof(MAGIC));
+        out.write((const char *)&shape, sizeof(shape));
+        out << vk << pk;
+        out.close();
+
+        if (out)
+            std::filesystem::rename(tmp, path, ec);
+
+        if (!out || ec)
+        {
+            std::filesystem::remove(tmp, ec);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool load(const std::string &path, uint64_t shape)
+    {
+        // the proving key is large (GBs for heights 24-30), map it instead of reading it
+        MmapIStream in{path};
+        uint64_t magic = 0;
+        uint64_t file_shape = 0;
+
+        if (!in.is_open())
+            return false;
+
+        in.read((char *)&magic, sizeof(magic));
+        in.read((char *)&file_shape, sizeof(file_shape));
+
+        if (!in || magic != MAGIC || file_shape != shape)
+            return false;
+
+        in >> vk >> pk;
+
+        return !in.fail();
+    }
+};
+
+static inline uint64_t fnv1a(const std::string &s)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (unsigned char c : s)
+    {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+
+    return h;
+}
+
+template<typename ppT, typename GadTree>
+uint64_t circuit_shape(size_t height)
+{
+    // Everything that changes the constraint system must be part of the key: the circuit type,
+    // the permutation parameters, the tree height and the curve (both the pairing and Fr).
+    using Hash = typename GadTree::GadHash::Hash;
+
+    std::stringstream ss;
+
+    ss << typeid(GadTree).name() << ';' << Hash::ROUNDS_N << ';' << hash_rate<Hash>::value << ';'
+       << hash_capacity<Hash>::value << ';' << height << ';' << typeid(ppT).name() << ';'
+       << libff::Fr<ppT>::mod;
+
+    return fnv1a(ss.str());
+}
+
+template<typename ppT, typename GadTree>
+std::string keypair_cache_path(const std::string &dir, size_t height)
+{
+    std::stringstream ss;
+
+    ss << dir << "/keypair_" << std::hex << circuit_shape<ppT, GadTree>(height) << ".bin";
+
+    return ss.str();
+}
+
+template<typename ppT, typename GadTree>
+r1cs_ppzksnark_keypair<ppT>
+r1cs_ppzksnark_cached_generator(const std::string &dir, size_t height,
+                                const libsnark::r1cs_ppzksnark_constraint_system<ppT> &cs)
+{
+    const uint64_t shape = circuit_shape<ppT, GadTree>(height);
+    const std::string path = keypair_cache_path<ppT, GadTree>(dir, height);
+
+    r1cs_ppzksnark_keypair<ppT> keypair;
+
+    // The shape only names the circuit: a gadget change can keep its size and still change its
+    // coefficients, so a cached key is used only if it holds exactly this constraint system. The
+    // generator stores it with A and B swapped when that makes B lighter, compare in that form.
+    if (keypair.load(path, shape))
+    {
+        libsnark::r1cs_ppzksnark_constraint_system<ppT> expected{cs};
+
+        expected.swap_AB_if_beneficial();
+
+        if (keypair.pk.constraint_system == expected)
+            return keypair;
+    }
+
+    keypair = libsnark::r1cs_ppzksnark_generator<ppT>(cs);
+
+    if (!keypair.save(path, shape))
+        std::cerr << "r1cs_ppzksnark_cached_generator: Could not write " << path << '\n';
+
+    return keypair;
+}
+
+/*
+Proves many witnesses of the same circuit with a shared proving key.
+Proofs are independent, so each thread of the pool runs one whole proof at a time. Nested
+parallelism is off during the batch, so libsnark's own parallel loops run serially inside a proof.
+The proving key is only read.
+libff's profiling state is global and not thread safe, so its counters are off during the batch.
+*/
+template<typename ppT>
+std::vector<libsnark::r1cs_ppzksnark_proof<ppT>> r1cs_ppzksnark_batch_prover(
+    const libsnark::r1cs_ppzksnark_proving_key<ppT> &pk,
+    const std::vector<libsnark::r1cs_ppzksnark_primary_input<ppT>> &primary_inputs,
+    const std::vector<libsnark::r1cs_ppzksnark_auxiliary_input<ppT>> &auxiliary_inputs,
+    int threads = omp_get_max_threads())
+{
+    std::vector<libsnark::r1cs_ppzksnark_proof<ppT>> proofs(primary_inputs.size());
+    const int levels = omp_get_max_active_levels();
+    const bool inhibit = libff::inhibit_profiling_counters;
+
+    omp_set_max_active_levels(1);
+    libff::inhibit_profiling_counters = true;
+
+#pragma omp parallel for num_threads(threads) schedule(dynamic, 1)
+    for (size_t i = 0; i < proofs.size(); ++i)
+        proofs[i] = libsnark::r1cs_ppzksnark_prover<ppT>(pk, primary_inputs[i], auxiliary_inputs[i]);
+
+    libff::inhibit_profiling_counters = inhibit;
+    omp_set_max_active_levels(levels);
+
+    return proofs;
+}
+
+/*
+Wall-clock breakdown of one proof, in milliseconds, read from libff's profiling blocks.
+The witness map computes the QAP polynomial H and includes the FFTs; every query is one
+multiexponentiation over the corresponding part of the proving key.
+*/
+struct r1cs_ppzksnark_prover_phases
+{
+    static constexpr const char *NAMES[] = {"Witness map", "FFT",     "A-query", "B-query",
+                                            "C-query",     "H-query", "K-query", "Prover"};
+    static constexpr size_t PHASES_N = std::size(NAMES);
+
+    std::array<double, PHASES_N> ms{};
 };
+
+/*
+Same as libsnark's prover, but with libff's profiling counters on (and its printing off) for the
+duration of the proof, so that the time of each phase can be collected afterwards.
+*/
+template<typename ppT>
+libsnark::r1cs_ppzksnark_proof<ppT>
+r1cs_ppzksnark_profiled_prover(const libsnark::r1cs_ppzksnark_proving_key<ppT> &pk,
+                               const libsnark::r1cs_ppzksnark_primary_input<ppT> &primary_input,
+                               const libsnark::r1cs_ppzksnark_auxiliary_input<ppT> &auxiliary_input,
+                               r1cs_ppzksnark_prover_phases &phases)
+{
+    // the FFTs of r1cs_to_qap_witness_map: A, B and C to coefficients and on to the coset, then H
+    static const char *FFT_BLOCKS[] = {"Compute coefficients of polynomial A",
+                                       "Compute coefficients of polynomial B",
+                                       "Compute evaluation of polynomial A on set T",
+                                       "Compute evaluation of polynomial B on set T",
+                                       "Compute coefficients of polynomial C",
+                                       "Compute evaluation of polynomial C on set T",
+                                       "Compute coefficients of polynomial H"};
+
+    const bool inhibit_info = libff::inhibit_profiling_info;
+    const bool inhibit_counters = libff::inhibit_profiling_counters;
+
+    libff::inhibit_profiling_info = true;
+    libff::inhibit_profiling_counters = false;
+    libff::clear_profiling_counters();
+
+    auto proof{libsnark::r1cs_ppzksnark_prover<ppT>(pk, primary_input, auxiliary_input)};
+
+    auto block_ms = [](const char *name)
+    {
+        auto it = libff::last_times.find(name);
+
+        return it == libff::last_times.end() ? 0. : it->second / 1'000'000.;
+    };
+
+    phases.ms = {block_ms("Call to r1cs_to_qap_witness_map"),
+                 0.,
+                 block_ms("Compute evaluation to A-query"),
+                 block_ms("Compute evaluation to B-query"),
+                 block_ms("Compute evaluation to C-query"),
+                 block_ms("Compute evaluation to H-query"),
+                 block_ms("Compute evaluation to K-query"),
+                 block_ms("Call to r1cs_ppzksnark_prover")};
+
+    for (auto &&b : FFT_BLOCKS)
+        phases.ms[1] += block_ms(b);
+
+    libff::clear_profiling_counters();
+    libff::inhibit_profiling_counters = inhibit_counters;
+    libff::inhibit_profiling_info = inhibit_info;
+
+    return proof;
+}
@@ -1,9 +1,13 @@
 #pragma once
 
+#include "util/allocator.hpp"
 #include "util/string_utils.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cstring>
 #include <iostream>
+#include <numeric>
 #include <omp.h>
 #include <vector>
 
@@ -72,9 +76,49 @@ private:
 
     static constexpr size_t LEAVES_N = 1ULL << (height - 1);
 
-    std::vector<Node> nodes{};
+    // Nodes filling a whole number of cache lines
+    static constexpr size_t CHUNK = CACHE_LINE_SIZE / std::gcd(sizeof(Node), CACHE_LINE_SIZE);
+
+    // First node of each level, from the leaves up: levels start on a cache line
+    static constexpr auto LEVELS = []
+    {
+        std::array<size_t, height + 1> l{};
+
+        for (size_t i = 0, n = LEAVES_N; i < height; ++i, n /= 2)
+            l[i + 1] = l[i] + (n + CHUNK - 1) / CHUNK * CHUNK;
+
+        return l;
+    }();
+
+    /*
+    Nodes layout is as follows:
+    - The first LEAVES_N nodes contain the leaves
+    - The remaining nodes are the internal nodes of the tree, level after level
+    Each level is padded to a cache line, get_node() skips the padding.
+    */
+    std::vector<Node, CacheAlignedAllocator<Node>> nodes{};
     Node *root = nullptr;
 
+    /*
+    Calls build(j) for the n nodes of a level. Every thread gets a contiguous range of them which
+    starts on a cache line, so that no two threads write the same line.
+    */
+    template<typename Fn>
+    static void build_level(size_t n, Fn build)
+    {
+    #pragma omp parallel
+        {
+            size_t chunks = (n + CHUNK - 1) / CHUNK;
+            size_t t = omp_get_thread_num();
+            size_t threads = omp_get_num_threads();
+            size_t begin = std::min(n, chunks * t / threads * CHUNK);
+            size_t end = std::min(n, chunks * (t + 1) / threads * CHUNK);
+
+            for (size_t j = begin; j < end; ++j)
+                build(j);
+        }
+    }
+
 public:
     static constexpr size_t INPUT_SIZE = LEAVES_N * Hash::BLOCK_SIZE;
 
@@ -92,69 +136,70 @@ public:
         FixedMTree(&*begin, std::distance(begin, end) * sizeof(*begin))
     {}
 
-    FixedMTree(const void *vdata, size_t sz) : nodes((1ULL << height) - 1), root{&nodes.back()}
+    FixedMTree(const void *vdata, size_t sz) :
+        nodes(LEVELS[height]), root{&nodes[LEVELS[height - 1]]}
+    {
+        rebuild(vdata, sz);
+    }
+
+    /*
+    Builds the tree of new data in the nodes of the current one, so that only the first build of
+    a default constructed tree allocates. Returns false (and leaves the tree unchanged) if the
+    size of the data is wrong.
+    */
+    bool rebuild(const void *vdata, size_t sz)
     {
         if (sz != INPUT_SIZE)
         {
             std::cerr << "FixedMTree: Bad size of input data\n";
-            return;
+            return false;
+        }
+
+        if (nodes.size() != LEVELS[height])
+        {
+            nodes.resize(LEVELS[height]);
+            root = &nodes[LEVELS[height - 1]];
         }
 
         const uint8_t *data = (const uint8_t *)vdata;
-        size_t depth = height - 1;
 
-// serial code
-#if 0
-        // add leaves
-            for (size_t i = 0; i < LEAVES_N; ++i)
-                this->nodes[i] = {data + Hash::BLOCK_SIZE * i,
-                                  data + Hash::BLOCK_SIZE * i + Hash::DIGEST_SIZE, depth};
-
-            // build tree bottom-up
-            for (size_t i = 0, last = LEAVES_N, len = LEAVES_N; depth > 0; len += 1ULL << depth)
-            {
-                --depth;
-                while (i < len)
-                {
-                    this->nodes[last] = {this->nodes[i].get_digest().data(), this->nodes[i + 1].get_digest().data(), depth};
-
-                    this->nodes[last].l = &this->nodes[i];
-                    this->nodes[last].r = &this->nodes[i + 1];
-                    this->nodes[i].f = &this->nodes[last];
-                    this->nodes[i + 1].f = &this->nodes[last];
-                    i += 2;
-                    ++last;
-                }
-            }
-#else // parallel code
-    #pragma omp parallel for
+        // Every thread only writes the nodes it builds: parents are linked to their children, and
+        // children to the (not yet built) parents, by index, so no thread writes the cache lines of
+        // the previous level
         // add leaves
-        for (size_t i = 0; i < LEAVES_N; ++i)
-            this->nodes[i] = {data + Hash::BLOCK_SIZE * i,
-                              data + Hash::BLOCK_SIZE * i + Hash::DIGEST_SIZE, depth};
+        build_level(LEAVES_N,
+                    [&](size_t j)
+                    {
+                        nodes[j] = {data + Hash::BLOCK_SIZE * j,
+                                    data + Hash::BLOCK_SIZE * j + Hash::DIGEST_SIZE, height - 1};
+
+                        if (height > 1)
+                            nodes[j].f = &nodes[LEVELS[1] + j / 2];
+                    });
 
         // build tree bottom-up
-        for (size_t i = 0, last = LEAVES_N, len = LEAVES_N; depth > 0; len += 1ULL << depth)
+        for (size_t l = 1, n = LEAVES_N / 2; l < height; ++l, n /= 2)
         {
-            size_t iters = (len - i) >> 1;
-            --depth;
-    #pragma omp parallel for
-            for (size_t j = 0; j < iters; ++j)
-            {
-                size_t k = i + j * 2;
-                size_t l = last + j;
-                this->nodes[l] = {this->nodes[k].get_digest().data(),
-                                  this->nodes[k + 1].get_digest().data(), depth};
-
-                this->nodes[l].l = &this->nodes[k];
-                this->nodes[l].r = &this->nodes[k + 1];
-                this->nodes[k].f = &this->nodes[l];
-                this->nodes[k + 1].f = &this->nodes[l];
-            }
-            last += iters;
-            i += iters * 2;
+            Node *out = &nodes[LEVELS[l]];
+            Node *in = &nodes[LEVELS[l - 1]];
+            Node *up = l + 1 < height ? &nodes[LEVELS[l + 1]] : nullptr;
+            size_t depth = height - 1 - l;
+
+            build_level(n,
+                        [&](size_t j)
+                        {
+                            out[j] = {in[2 * j].get_digest().data(),
+                                      in[2 * j + 1].get_digest().data(), depth};
+
+                            out[j].l = &in[2 * j];
+                            out[j].r = &in[2 * j + 1];
+
+                            if (up)
+                                out[j].f = &up[j / 2];
+                        });
         }
-#endif
+
+        return true;
     }
 
     const auto &digest() const
@@ -162,9 +207,15 @@ public:
         return root->get_digest();
     }
 
+    // i-th node, counting the leaves first and then each level up to the root
     const Node *get_node(size_t i) const
     {
-        return &nodes[i];
+        size_t l = 0;
+
+        for (size_t n = LEAVES_N; i >= n && l + 1 < height; i -= n, n /= 2)
+            ++l;
+
+        return &nodes[LEVELS[l] + i];
     }
 
     friend std::ostream &operator<<(std::ostream &os, const FixedMTree &tree)
@@ -1,60 +1,81 @@
 #pragma once
 
+#include "util/allocator.hpp"
 #include "util/const_math.hpp"
 #include "util/string_utils.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cstring>
 #include <iostream>
+#include <numeric>
 #include <omp.h>
+#include <type_traits>
 #include <vector>
 
 #if __cplusplus >= 202002L
     #include <ranges>
 #endif
 
+// Pages backing the nodes of an MTree
+enum class MTreePages
+{
+    DEFAULT,  // std::allocator
+    HUGE_2MB, // 2 MB huge pages (reserved or transparent)
+    HUGE_1GB  // 1 GB huge pages if reserved, otherwise as HUGE_2MB
+};
+
 template<typename Hash>
 class MTreeNode
 {
 public:
     static constexpr size_t ARITY = Hash::BLOCK_SIZE / Hash::DIGEST_SIZE;
 
+    using Digest = std::array<uint8_t, Hash::DIGEST_SIZE>;
+
 private:
-    std::array<uint8_t, Hash::DIGEST_SIZE> digest;
+    // Digests are stored apart from the links, by the tree: builds only write digests, while the
+    // links only depend on the shape of the tree and are set once
+    const Digest *digest;
     MTreeNode *f;
     std::array<MTreeNode *, ARITY> c;
     size_t depth;
 
-    template<size_t, typename>
+    template<size_t, typename, MTreePages>
     friend class MTree;
 
     template<size_t, typename>
     friend class MTreePath;
 
-public:
-    MTreeNode() = default;
-    MTreeNode(const MTreeNode &) = default;
-    MTreeNode(MTreeNode &&) = default;
-    MTreeNode &operator=(const MTreeNode &) = default;
-    MTreeNode &operator=(MTreeNode &&) = default;
-
-    MTreeNode(const void *data, size_t depth) : digest{}, f{}, c{}, depth{depth}
+    void link(const Digest *digest, MTreeNode *f, size_t depth)
     {
-        Hash::hash_oneblock(this->digest.data(), data);
+        this->digest = digest;
+        this->f = f;
+        this->c.fill(nullptr);
+        this->depth = depth;
     }
 
-    MTreeNode(const std::array<const void *, ARITY> &data, size_t depth) :
-        digest{}, f{}, c{}, depth{depth}
+    // Moves the links to a copy of the tree, whose nodes and digests are off and doff away
+    void relink(ptrdiff_t off, ptrdiff_t doff)
     {
-        std::array<uint8_t, Hash::BLOCK_SIZE> block;
+        digest += doff;
 
-        for (size_t i = 0; i < ARITY; ++i)
-            memcpy(block.data() + i * Hash::DIGEST_SIZE, data[i], Hash::DIGEST_SIZE);
+        if (f)
+            f += off;
 
-        Hash::hash_oneblock(this->digest.data(), block.data());
+        for (size_t i = 0; i < ARITY; ++i)
+            if (c[i])
+                c[i] += off;
     }
 
-    const auto &get_digest() const { return digest; }
+public:
+    MTreeNode() = default;
+    MTreeNode(const MTreeNode &) = default;
+    MTreeNode(MTreeNode &&) = default;
+    MTreeNode &operator=(const MTreeNode &) = default;
+    MTreeNode &operator=(MTreeNode &&) = default;
+
+    const Digest &get_digest() const { return *digest; }
     const MTreeNode *parent() const { return f; }
     const MTreeNode *child(size_t i) const { return c[i]; }
 
@@ -63,7 +84,7 @@ public:
         for (size_t i = 0; i < node.depth; ++i)
             os << "    ";
 
-        os << "*: " << hexdump(node.digest) << '\n';
+        os << "*: " << hexdump(*node.digest) << '\n';
 
         for (size_t i = 0; i < ARITY; ++i)
             if (node.c[i] != nullptr)
@@ -73,62 +94,113 @@ public:
     }
 };
 
-template<size_t height, typename Hash>
+template<size_t height, typename Hash, MTreePages pages = MTreePages::DEFAULT>
 class MTree
 {
 public:
     using Node = MTreeNode<Hash>;
+    using Digest = typename Node::Digest;
+    template<typename T>
+    using Allocator = std::conditional_t<
+        pages == MTreePages::DEFAULT, DefaultInitAllocator<T, CacheAlignedAllocator<T>>,
+        DefaultInitAllocator<T, HugePageAllocator<T, pages == MTreePages::HUGE_1GB
+                                                         ? HUGE_PAGE_1GB
+                                                         : HUGE_PAGE_2MB>>>;
 
     static constexpr size_t ARITY = Hash::BLOCK_SIZE / Hash::DIGEST_SIZE;
     static constexpr size_t LEAVES_N = pow(ARITY, height - 1);
     static constexpr size_t NODES_N = pow_sum(ARITY, (size_t)0, height);
     static constexpr size_t INPUT_SIZE = LEAVES_N * Hash::BLOCK_SIZE;
 
+    static_assert(sizeof(Digest) == Hash::DIGEST_SIZE, "ARITY digests must make up a block");
+
 private:
+    // Digests filling a whole number of cache lines
+    static constexpr size_t CHUNK = CACHE_LINE_SIZE / std::gcd(sizeof(Digest), CACHE_LINE_SIZE);
+
+    // First digest of each level, from the leaves up: levels start on a cache line
+    static constexpr auto LEVELS = []
+    {
+        std::array<size_t, height + 1> l{};
+
+        for (size_t i = 0, n = LEAVES_N; i < height; ++i, n /= ARITY)
+            l[i + 1] = l[i] + (n + CHUNK - 1) / CHUNK * CHUNK;
+
+        return l;
+    }();
+
     /*
     Nodes layout is as follows:
     - The first LEAVES_N nodes contain the leaves
     - The remaining nodes are the internal nodes of the tree
+    Digests follow the same order, in a separate array where each level is padded to a cache line.
+    The children of a node are ARITY consecutive digests, i.e. the block hashed by the node.
+    Digests are not zero-filled on allocation, as every build overwrites all of them: with
+    MULTICORE, the first build is also the first touch of every page, by the thread which then
+    keeps building that part of the tree (on its NUMA node).
     */
-    std::vector<Node> nodes;
-    Node *root;
+    std::vector<Digest, Allocator<Digest>> digests;
+    std::vector<Node, Allocator<Node>> nodes;
+    Node *root = nullptr;
 
-public:
-    MTree() = default;
-    MTree(const MTree &other) : nodes{other.nodes}, root{&nodes.back()}
+    // Allocate the storage and link the nodes, which depends on the shape of the tree only
+    void allocate()
     {
-        // fixup pointers
-        ptrdiff_t off = nodes.data() - other.nodes.data();
+        digests.resize(LEVELS[height]);
+        nodes.resize(NODES_N);
+        root = &nodes.back();
 
-        for (size_t i = 0; i < NODES_N; ++i)
-        {
-            if (nodes[i].f)
-                nodes[i].f += off;
+        for (size_t l = 0, i = 0, n = LEAVES_N; l < height; i += n, ++l, n /= ARITY)
+            for (size_t j = 0; j < n; ++j)
+            {
+                Node &node = nodes[i + j];
+
+                Node *f = l + 1 < height ? &nodes[i + n + j / ARITY] : nullptr;
+
+                node.link(&digests[LEVELS[l] + j], f, height - 1 - l);
 
-            for (size_t j = 0; j < ARITY; ++j)
-                if (nodes[i].c[j])
-                    nodes[i].c[j] += off;
+                if (l > 0)
+                    for (size_t k = 0; k < ARITY; ++k)
+                        node.c[k] = &nodes[i - n * ARITY + j * ARITY + k];
+            }
+    }
+
+    /*
+    Calls build(j) for the n digests of a level. With MULTICORE, every thread gets a contiguous
+    range of them which starts on a cache line, so that no two threads write the same line.
+    */
+    template<typename Fn>
+    static void build_level(size_t n, Fn build)
+    {
+#ifdef MULTICORE
+    #pragma omp parallel
+#endif
+        {
+            size_t chunks = (n + CHUNK - 1) / CHUNK;
+            size_t t = omp_get_thread_num();
+            size_t threads = omp_get_num_threads();
+            size_t begin = std::min(n, chunks * t / threads * CHUNK);
+            size_t end = std::min(n, chunks * (t + 1) / threads * CHUNK);
+
+            for (size_t j = begin; j < end; ++j)
+                build(j);
         }
     }
+
+public:
+    MTree() = default;
+    MTree(const MTree &other) { *this = other; }
     MTree(MTree &&other) = default;
 
     MTree &operator=(const MTree &other)
     {
-        nodes = other.nodes;
-        root = &nodes.back();
+        if (other.nodes.empty())
+            return *this = MTree{};
 
-        // fixup pointers
-        ptrdiff_t off = nodes.data() - other.nodes.data();
+        if (nodes.size() != NODES_N)
+            allocate();
 
-        for (size_t i = 0; i < NODES_N; ++i)
-        {
-            if (nodes[i].f)
-                nodes[i].f += off;
-
-            for (size_t j = 0; j < ARITY; ++j)
-                if (nodes[i].c[j])
-                    nodes[i].c[j] += off;
-        }
+        std::copy(other.digests.begin(), other.digests.end(), digests.begin());
 
         return *this;
     }
@@ -149,53 +221,49 @@ public:
         MTree{&*begin, std::distance(begin, end) * sizeof(*begin)}
     {}
 
-    MTree(const void *vdata, size_t sz) : nodes(NODES_N), root{&nodes.back()}
+    MTree(const void *vdata, size_t sz)
+    {
+        allocate();
+
+        if (!rebuild(vdata, sz))
+            std::fill(digests.begin(), digests.end(), Digest{});
+    }
+
+    /*
+    Builds the tree of new data in the storage of the current one, so that only the first build
+    of a default constructed tree allocates, and only digests are written. Returns false (and
+    leaves the tree unchanged) if the size of the data is wrong.
+    */
+    bool rebuild(const void *vdata, size_t sz)
     {
         if (sz != INPUT_SIZE)
         {
             std::cerr << "MTree: Bad size of input data\n";
-            return;
+            return false;
         }
 
+        if (nodes.size() != NODES_N)
+            allocate();
+
         const uint8_t *data = (const uint8_t *)vdata;
-        size_t depth = height - 1;
 
-#ifdef MULTICORE
-    #pragma omp parallel for
-#endif
         // add leaves
-        for (size_t i = 0; i < LEAVES_N; ++i)
-            this->nodes[i] = Node{data + i * Hash::BLOCK_SIZE, depth};
+        build_level(LEAVES_N, [&](size_t j)
+                    { Hash::hash_oneblock(digests[j].data(), data + j * Hash::BLOCK_SIZE); });
 
-        // build tree bottom-up
-        for (size_t i = 0, len = LEAVES_N; depth > 0; i += len * ARITY)
+        // build tree bottom-up, hashing the children of each node where they are
+        for (size_t l = 1, n = LEAVES_N / ARITY; l < height; ++l, n /= ARITY)
         {
-            size_t last = i + len;
-            --depth;
-            len /= ARITY;
+            Digest *out = &digests[LEVELS[l]];
+            const Digest *in = &digests[LEVELS[l - 1]];
 
-#ifdef MULTICORE
-    #pragma omp parallel for
-#endif
-            for (size_t j = 0; j < len; ++j)
-            {
-                std::array<const void *, ARITY> children;
-
-                for (size_t k = 0; k < ARITY; ++k)
-                    children[k] = this->nodes[i + j * ARITY + k].digest.data();
-
-                this->nodes[last + j] = Node{children, depth};
-
-                for (size_t k = 0; k < ARITY; ++k)
-                {
-                    this->nodes[last + j].c[k] = &this->nodes[i + j * ARITY + k];
-                    this->nodes[i + j * ARITY + k].f = &this->nodes[last + j];
-                }
-            }
+            build_level(n, [&](size_t j) { Hash::hash_oneblock(out[j].data(), in + j * ARITY); });
         }
+
+        return true;
     }
 
-    const uint8_t *digest() const { return root->digest.data(); }
+    const uint8_t *digest() const { return root->digest->data(); }
 
     const Node *get_node(size_t i) const { return &nodes[i]; }
 
@@ -214,6 +282,7 @@ class MTreePath
 {
 public:
     using Node = MTreeNode<Hash>;
+    using Digest = typename Node::Digest;
 
     static constexpr size_t ARITY = Hash::BLOCK_SIZE / Hash::DIGEST_SIZE;
     static constexpr size_t LEAVES_N = pow(ARITY, height - 1);
@@ -224,48 +293,39 @@ public:
 private:
     /*
     Nodes layout is as follows:
-    - nodes contain the path to the root
+    - nodes contain the path to the root, and digests their digests
     */
+    std::vector<Digest> digests;
     std::vector<Node> nodes;
     Node *root;
 
 public:
     MTreePath() = default;
 
-    MTreePath(const MTreePath &other) : nodes{other.nodes}, root{&nodes.back()}
+    MTreePath(const MTreePath &other) :
+        digests{other.digests}, nodes{other.nodes}, root{&nodes.back()}
     {
         // fixup pointers
         ptrdiff_t off = nodes.data() - other.nodes.data();
+        ptrdiff_t doff = digests.data() - other.digests.data();
 
         for (size_t i = 0; i < NODES_N; ++i)
-        {
-            if (nodes[i].f)
-                nodes[i].f += off;
-
-            for (size_t j = 0; j < ARITY; ++j)
-                if (nodes[i].c[j])
-                    nodes[i].c[j] += off;
-        }
+            nodes[i].relink(off, doff);
     }
     MTreePath(MTreePath &&other) = default;
 
     MTreePath &operator=(const MTreePath &other)
     {
+        digests = other.digests;
         nodes = other.nodes;
         root = &nodes.back();
 
         // fixup pointers
         ptrdiff_t off = nodes.data() - other.nodes.data();
+        ptrdiff_t doff = digests.data() - other.digests.data();
 
         for (size_t i = 0; i < NODES_N; ++i)
-        {
-            if (nodes[i].f)
-                nodes[i].f += off;
-
-            for (size_t j = 0; j < ARITY; ++j)
-                if (nodes[i].c[j])
-                    nodes[i].c[j] += off;
-        }
+            nodes[i].relink(off, doff);
 
         return *this;
     }
@@ -276,17 +336,21 @@ public:
     template<std::ranges::range Range>
     MTreePath(const Range &range, size_t idx = 0) :
         MTreePath{std::ranges::cdata(range),
-                  std::ranges::size(range) * sizeof(*std::ranges::cdata(range))}
+                  std::ranges::size(range) * sizeof(*std::ranges::cdata(range)), idx}
     {}
 #endif
 
     template<typename Iter>
     MTreePath(const Iter begin, const Iter end, size_t idx = 0) :
-        MTreePath{&*begin, std::distance(begin, end) * sizeof(*begin)}
+        MTreePath{&*begin, std::distance(begin, end) * sizeof(*begin), idx}
     {}
 
-    MTreePath(const void *vdata, size_t sz, size_t idx = 0) : nodes(NODES_N), root{&nodes.back()}
+    MTreePath(const void *vdata, size_t sz, size_t idx = 0) :
+        digests(NODES_N), nodes(NODES_N), root{&nodes.back()}
     {
+        for (size_t i = 0; i < NODES_N; ++i)
+            nodes[i].link(&digests[i], nullptr, height - 1 - i);
+
         if (sz != INPUT_SIZE)
         {
             std::cerr << "MTreePath: Bad size of input data\n";
@@ -294,38 +358,32 @@ public:
         }
 
         const uint8_t *data = (const uint8_t *)vdata;
-        size_t depth = height - 1;
 
         // bootstrap first node of the path
-        this->nodes[0] = Node{data, depth};
+        Hash::hash_oneblock(digests[0].data(), data);
 
         // build tree bottom-up
         for (size_t i = 1; i < height; ++i, idx /= ARITY)
         {
-            std::array<const void *, ARITY> children;
+            std::array<uint8_t, Hash::BLOCK_SIZE> block;
             size_t off = Hash::BLOCK_SIZE + (i - 1) * (ARITY - 1) * Hash::DIGEST_SIZE;
             size_t j = idx % ARITY;
 
-            --depth;
-
             // build correct permutation depending on idx
-            for (size_t k = 0; k < j; ++k)
-                children[k] = data + off + k * Hash::DIGEST_SIZE;
-
-            children[j] = this->nodes[i - 1].digest.data();
-
-            for (size_t k = j + 1; k < ARITY; ++k)
-                children[k] = data + off + (k - 1) * Hash::DIGEST_SIZE;
+            memcpy(block.data(), data + off, j * Hash::DIGEST_SIZE);
+            memcpy(block.data() + j * Hash::DIGEST_SIZE, digests[i - 1].data(), Hash::DIGEST_SIZE);
+            memcpy(block.data() + (j + 1) * Hash::DIGEST_SIZE, data + off + j * Hash::DIGEST_SIZE,
+                   (ARITY - 1 - j) * Hash::DIGEST_SIZE);
 
-            // create node and link children
-            this->nodes[i] = Node{children, depth};
+            // hash node and link children
+            Hash::hash_oneblock(digests[i].data(), block.data());
 
             this->nodes[i].c[j] = &this->nodes[i - 1];
             this->nodes[i - 1].f = &this->nodes[i];
         }
     }
 
-    const uint8_t *digest() const { return root->digest.data(); }
+    const uint8_t *digest() const { return root->digest->data(); }
 
     const Node *get_node(size_t i) const { return &nodes[i]; }
 
@@ -194,6 +194,87 @@ FieldT modular_inverse(const FieldT &x, const FieldT &modulus)
     return u;
 }
 
+// Window of power_lanes() for exponents of more than 64 bits, the smaller ones use plain
+// square-and-multiply
+static constexpr size_t POWER_WINDOW_BITS = 4;
+
+/*
+Raises every x[k] to the same power e, one step for all the elements at a time: the n products of
+a step are independent, so they overlap in the pipeline instead of forming n long chains one after
+the other. The addition chain is a left-to-right sliding window over the bits of e: after the odd
+powers x, x^3, ..., x^(2^w - 1), it costs one squaring per bit and one multiplication per window,
+about bits / (w + 1) of them instead of the bits / 2 of square-and-multiply.
+*/
+template<typename Field, size_t n, typename Bigint>
+void power_lanes(std::array<Field, n> &x, const Bigint &e)
+{
+    static constexpr size_t ODD_N = (size_t)1 << (POWER_WINDOW_BITS - 1);
+
+    const size_t bits{e.num_bits()};
+    const size_t w{bits > 64 ? POWER_WINDOW_BITS : 1};
+
+    if (!bits)
+    {
+        x.fill(Field::one());
+        return;
+    }
+
+    // odd[m][k] = x[k]^(2m + 1)
+    std::array<std::array<Field, n>, ODD_N> odd;
+
+    odd[0] = x;
+    if (w > 1)
+    {
+        std::array<Field, n> x2;
+
+        for (size_t k = 0; k < n; ++k)
+            x2[k] = x[k].squared();
+
+        for (size_t m = 1; m < ODD_N; ++m)
+            for (size_t k = 0; k < n; ++k)
+                odd[m][k] = odd[m - 1][k] * x2[k];
+    }
+
+    // The top window starts the chain, every other one is squared into place and multiplied in
+    bool first = true;
+
+    for (size_t i = bits; i-- > 0;)
+    {
+        if (!e.test_bit(i))
+        {
+            for (auto &&y : x)
+                y *= y;
+
+            continue;
+        }
+
+        // Bits i down to j, the lowest one set
+        size_t j = i + 1 > w ? i + 1 - w : 0;
+        size_t m = 0;
+
+        while (!e.test_bit(j))
+            ++j;
+
+        for (size_t b = i + 1; b-- > j;)
+        {
+            m = m << 1 | e.test_bit(b);
+
+            if (!first)
+                for (auto &&y : x)
+                    y *= y;
+        }
+
+        if (first)
+            x = odd[m >> 1];
+        else
+            for (size_t k = 0; k < n; ++k)
+                x[k] *= odd[m >> 1][k];
+
+        first = false;
+        i = j;
+    }
+}
+
 template<typename FieldT, size_t sz>
 static constexpr std::array<FieldT, sz> random_array()
 {
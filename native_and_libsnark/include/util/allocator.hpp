@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <sys/mman.h>
+#include <type_traits>
+#include <utility>
+
+template<typename T, typename Alloc = std::allocator<T>>
+class DefaultInitAllocator : public Alloc
+{
+    /* DefaultInitAllocator
+    * Allocator adaptor which default-initializes the elements a container creates without a value
+    * (e.g. std::vector<T, DefaultInitAllocator<T>> v(n) or v.resize(n)) instead of
+    * value-initializing them. Trivially default constructible types are then left uninitialized
+    * rather than zero-filled, which saves a pass over buffers that are overwritten anyway.
+    */
+    using traits = std::allocator_traits<Alloc>;
+
+public:
+    template<typename U>
+    struct rebind
+    {
+        using other = DefaultInitAllocator<U, typename traits::template rebind_alloc<U>>;
+    };
+
+    using Alloc::Alloc;
+
+    DefaultInitAllocator() = default;
+
+    template<typename U, typename A>
+    DefaultInitAllocator(const DefaultInitAllocator<U, A> &other) noexcept :
+        Alloc{static_cast<const A &>(other)}
+    {}
+
+    template<typename U>
+    void construct(U *p) noexcept(std::is_nothrow_default_constructible_v<U>)
+    {
+        ::new (static_cast<void *>(p)) U;
+    }
+
+    template<typename U, typename... Args>
+    void construct(U *p, Args &&...args)
+    {
+        traits::construct(static_cast<Alloc &>(*this), p, std::forward<Args>(args)...);
+    }
+};
+
+static constexpr size_t HUGE_PAGE_2MB = 1ULL << 21;
+static constexpr size_t HUGE_PAGE_1GB = 1ULL << 30;
+
+template<typename T, size_t page = HUGE_PAGE_2MB>
+class HugePageAllocator
+{
+    /* HugePageAllocator
+    * Allocator for large arrays, backed by huge pages of the given size (2 MB or 1 GB) to cut TLB
+    * misses. Allocations are mapped with MAP_HUGETLB if the kernel has enough reserved huge pages,
+    * and otherwise with regular pages, aligned to 2 MB, and madvise(MADV_HUGEPAGE) so that
+    * transparent huge pages can back them. Pages are not touched here: combined with
+    * DefaultInitAllocator, the first writes of the container's owner (e.g. the parallel loops of
+    * a tree build) place every page on the NUMA node of the thread which uses it.
+    */
+public:
+    using value_type = T;
+    using is_always_equal = std::true_type;
+
+    template<typename U>
+    struct rebind
+    {
+        using other = HugePageAllocator<U, page>;
+    };
+
+    HugePageAllocator() = default;
+
+    template<typename U>
+    HugePageAllocator(const HugePageAllocator<U, page> &) noexcept
+    {}
+
+    T *allocate(size_t n)
+    {
+        size_t len = length(n);
+        void *p = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB |
+                           (__builtin_ctzll(page) << MAP_HUGE_SHIFT),
+                       -1, 0);
+
+        if (p != MAP_FAILED)
+            return static_cast<T *>(p);
+
+        // Transparent huge pages are 2 MB whatever the requested size: round to 2 MB only, map
+        // more and trim both ends to a 2 MB aligned range
+        len = length(n, HUGE_PAGE_2MB);
+
+        uint8_t *q = (uint8_t *)mmap(nullptr, len + HUGE_PAGE_2MB, PROT_READ | PROT_WRITE,
+                                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if ((void *)q == MAP_FAILED)
+            throw std::bad_alloc{};
+
+        size_t head = -(uintptr_t)q & (HUGE_PAGE_2MB - 1);
+
+        if (head)
+            munmap(q, head);
+        munmap(q + head + len, HUGE_PAGE_2MB - head);
+        madvise(q + head, len, MADV_HUGEPAGE);
+
+        return reinterpret_cast<T *>(q + head);
+    }
+
+    void deallocate(T *p, size_t n) noexcept
+    {
+        // A MAP_HUGETLB mapping cannot be split off a huge page boundary, so unmapping it with the
+        // shorter length of the fallback fails (EINVAL) and leaves it whole for the second call
+        if (munmap(p, length(n, HUGE_PAGE_2MB)) != 0)
+            munmap(p, length(n));
+    }
+
+    template<typename U>
+    bool operator==(const HugePageAllocator<U, page> &) const noexcept
+    {
+        return true;
+    }
+
+    template<typename U>
+    bool operator!=(const HugePageAllocator<U, page> &) const noexcept
+    {
+        return false;
+    }
+
+private:
+    // Whole pages of the given size
+    static size_t length(size_t n, size_t size = page)
+    {
+        return (n * sizeof(T) + size - 1) & ~(size - 1);
+    }
+};
+
+static constexpr size_t CACHE_LINE_SIZE = 64;
+
+template<typename T>
+class CacheAlignedAllocator : public std::allocator<T>
+{
+    /* CacheAlignedAllocator
+    * std::allocator whose allocations start on a cache line, so that arrays can be split among
+    * threads at cache line boundaries.
+    */
+public:
+    template<typename U>
+    struct rebind
+    {
+        using other = CacheAlignedAllocator<U>;
+    };
+
+    CacheAlignedAllocator() = default;
+
+    template<typename U>
+    CacheAlignedAllocator(const CacheAlignedAllocator<U> &) noexcept
+    {}
+
+    T *allocate(size_t n)
+    {
+        return static_cast<T *>(
+            ::operator new(n * sizeof(T), std::align_val_t{std::max(CACHE_LINE_SIZE, alignof(T))}));
+    }
+
+    void deallocate(T *p, size_t) noexcept
+    {
+        ::operator delete(p, std::align_val_t{std::max(CACHE_LINE_SIZE, alignof(T))});
+    }
+};
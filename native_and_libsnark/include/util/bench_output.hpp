@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "hash_traits.hpp"
+#include "perf_counters.hpp"
+
+struct BenchStats
+{
+    size_t n = 0;
+    double mean = 0;
+    double median = 0;
+    double stddev = 0;
+    double min = 0;
+
+    static BenchStats of(std::vector<double> samples)
+    {
+        BenchStats s;
+
+        s.n = samples.size();
+
+        if (!s.n)
+            return s;
+
+        std::sort(samples.begin(), samples.end());
+
+        s.mean = std::accumulate(samples.begin(), samples.end(), 0.) / s.n;
+        s.median = s.n % 2 ? samples[s.n / 2] : (samples[s.n / 2 - 1] + samples[s.n / 2]) / 2;
+        s.min = samples.front();
+
+        for (auto &&x : samples)
+            s.stddev += (x - s.mean) * (x - s.mean);
+
+        s.stddev = s.n > 1 ? std::sqrt(s.stddev / (s.n - 1)) : 0;
+
+        return s;
+    }
+};
+
+// What a record was measured on: CPU, compiler, build flags and Makefile options
+static inline std::vector<std::pair<std::string, std::string>> bench_environment()
+{
+    std::string cpu = "unknown";
+    std::ifstream cpuinfo{"/proc/cpuinfo"};
+
+    for (std::string line; std::getline(cpuinfo, line);)
+        if (line.rfind("model name", 0) == 0)
+        {
+            cpu = line.substr(line.find(':') + 2);
+            break;
+        }
+
+    const char *curve =
+#if defined(CURVE_ALT_BN128)
+        "CURVE_ALT_BN128";
+#elif defined(CURVE_BLS12_381)
+        "CURVE_BLS12_381";
+#elif defined(CURVE_BN128)
+        "CURVE_BN128";
+#elif defined(CURVE_EDWARDS)
+        "CURVE_EDWARDS";
+#elif defined(CURVE_MNT4)
+        "CURVE_MNT4";
+#elif defined(CURVE_MNT6)
+        "CURVE_MNT6";
+#else
+        "unknown";
+#endif
+
+#if defined(__clang__)
+    std::string compiler = __VERSION__;
+#elif defined(__GNUC__)
+    std::string compiler = std::string("GCC ") + __VERSION__;
+#else
+    std::string compiler = "unknown";
+#endif
+
+#ifdef BUILD_CXXFLAGS
+    const char *flags = BUILD_CXXFLAGS;
+#else
+    const char *flags = "unknown";
+#endif
+
+#ifdef MULTICORE
+    const char *multicore = "1";
+#else
+    const char *multicore = "0";
+#endif
+
+#ifdef USE_ASM
+    const char *use_asm = "1";
+#else
+    const char *use_asm = "0";
+#endif
+
+    return {{"cpu", cpu},     {"compiler", compiler},   {"flags", flags},
+            {"curve", curve}, {"multicore", multicore}, {"use_asm", use_asm}};
+}
+
+class BenchOutput
+{
+    /* BenchOutput
+    * Writes benchmark results as <prefix>.csv and <prefix>.json, one record per hash
+    * configuration, tree height, thread count and phase. Every record carries its statistics (in
+    * milliseconds) and the environment, so files from different builds can be compared directly.
+    * Hardware counters, when given, are per node: empty in the CSV and null in the JSON otherwise.
+    */
+public:
+    BenchOutput(const std::string &prefix) :
+        csv{prefix + ".csv"}, json{prefix + ".json"}, env{bench_environment()}
+    {
+        csv.precision(9);
+        json.precision(9);
+
+        csv << "hash,rate,capacity,rounds,height,threads,phase,n,mean,median,stddev,min,nodes";
+        for (auto &&x : PerfCounts::NAMES)
+            csv << ',' << x;
+        csv << ",ipc";
+        for (auto &&[k, v] : env)
+            csv << ',' << k;
+        csv << '\n';
+
+        json << "[";
+    }
+
+    ~BenchOutput()
+    {
+        json << (first ? "]\n" : "\n]\n");
+    }
+
+    template<typename Hash>
+    void record(const std::string &hash, size_t height, int threads, const std::string &phase,
+                const BenchStats &s, const PerfCounts &c = {})
+    {
+        record(hash, hash_rate<Hash>::value, hash_capacity<Hash>::value, Hash::ROUNDS_N, height,
+               threads, phase, s, c);
+    }
+
+    void record(const std::string &hash, size_t rate, size_t capacity, size_t rounds,
+                size_t height, int threads, const std::string &phase, const BenchStats &s,
+                const PerfCounts &c = {})
+    {
+        csv << quote(hash, '"') << ',' << rate << ',' << capacity << ',' << rounds << ','
+            << height << ',' << threads << ',' << quote(phase, '"') << ',' << s.n << ','
+            << s.mean << ',' << s.median << ',' << s.stddev << ',' << s.min << ',' << c.nodes;
+        for (auto &&x : c.value)
+            csv << ',' << number(x, "");
+        csv << ',' << number(c.ipc(), "");
+        for (auto &&[k, v] : env)
+            csv << ',' << quote(v, '"');
+        csv << '\n';
+        csv.flush();
+
+        json << (first ? "\n  {" : ",\n  {") << "\"hash\": " << quote(hash, '\\')
+             << ", \"rate\": " << rate << ", \"capacity\": " << capacity
+             << ", \"rounds\": " << rounds << ", \"height\": " << height
+             << ", \"threads\": " << threads << ", \"phase\": " << quote(phase, '\\')
+             << ", \"n\": " << s.n << ", \"mean\": " << s.mean << ", \"median\": " << s.median
+             << ", \"stddev\": " << s.stddev << ", \"min\": " << s.min
+             << ", \"nodes\": " << c.nodes;
+        for (size_t i = 0; i < PERF_EVENTS_N; ++i)
+            json << ", \"" << PerfCounts::NAMES[i] << "\": " << number(c[i], "null");
+        json << ", \"ipc\": " << number(c.ipc(), "null");
+        for (auto &&[k, v] : env)
+            json << ", \"" << k << "\": " << quote(v, '\\');
+        json << '}';
+        json.flush();
+
+        first = false;
+    }
+
+private:
+    std::ofstream csv;
+    std::ofstream json;
+    std::vector<std::pair<std::string, std::string>> env;
+    bool first = true;
+
+    // Counters which were not measured are written as none
+    std::string number(double x, const char *none) const
+    {
+        if (std::isnan(x))
+            return none;
+
+        std::ostringstream out;
+
+        out.precision(9);
+        out << x;
+
+        return out.str();
+    }
+
+    // Double quotes, escaped with esc: "" for CSV, \" for JSON
+    static std::string quote(const std::string &s, char esc)
+    {
+        std::string q{'"'};
+
+        for (char c : s)
+        {
+            if (c == '"' || (esc == '\\' && c == '\\'))
+                q += esc;
+            q += c;
+        }
+
+        return q + '"';
+    }
+};
@@ -23,3 +23,15 @@ constexpr T pow_sum(T x, T s, T e)
     // Computes sum_{i = s}^{e-1} x^i
     return (pow(x, e) - pow(x, s)) / (x - 1);
 }
+
+template<typename T>
+constexpr T ilog2(T x)
+{
+    // floor(log2(x)) for x > 0
+    T r = 0;
+
+    while (x >>= 1)
+        ++r;
+
+    return r;
+}
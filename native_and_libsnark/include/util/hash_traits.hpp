@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+// Rate and capacity of a permutation, for hashes which do not have them (e.g. SHA-256) these are
+// the number of digests in a block and 0
+template<typename Hash, typename = void>
+struct hash_rate : std::integral_constant<size_t, Hash::BLOCK_SIZE / Hash::DIGEST_SIZE>
+{};
+
+template<typename Hash>
+struct hash_rate<Hash, std::void_t<decltype(Hash::RATE)>> :
+    std::integral_constant<size_t, Hash::RATE>
+{};
+
+template<typename Hash, typename = void>
+struct hash_capacity : std::integral_constant<size_t, 0>
+{};
+
+template<typename Hash>
+struct hash_capacity<Hash, std::void_t<decltype(Hash::CAPACITY)>> :
+    std::integral_constant<size_t, Hash::CAPACITY>
+{};
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <gmpxx.h>
+
+template<typename Field>
+class LazyField
+{
+    /* LazyField
+    * Unreduced accumulator for linear layers. It holds a sum of (Montgomery) representations of
+    * field elements in one limb more than the field, so additions, subtractions and doublings are
+    * plain carry chains without the conditional subtraction of Field::operator+=. Montgomery form
+    * is linear, so the sum represents the sum of the elements; reduce() brings it back below the
+    * modulus once, before the value enters the next multiplication or S-box.
+    * The extra limb leaves room for about 2^64 terms, far more than any linear layer adds up.
+    */
+public:
+    static constexpr size_t N = Field::num_limbs;
+
+    using Limbs = std::array<mp_limb_t, N + 1>;
+
+    LazyField() : v{} {}
+
+    LazyField(const Field &x)
+    {
+        for (size_t i = 0; i < N; ++i)
+            v[i] = x.mont_repr.data[i];
+        v[N] = 0;
+    }
+
+    LazyField &operator+=(const LazyField &x)
+    {
+        add(x.v.data(), N + 1);
+
+        return *this;
+    }
+
+    LazyField &operator+=(const Field &x)
+    {
+        add(x.mont_repr.data, N);
+
+        return *this;
+    }
+
+    // Adds p - x, which keeps the value non-negative
+    LazyField &operator-=(const Field &x)
+    {
+        add(Field::mod.data, N);
+        sub(x.mont_repr.data);
+
+        return *this;
+    }
+
+    LazyField operator+(const LazyField &x) const
+    {
+        LazyField r{*this};
+
+        return r += x;
+    }
+
+    LazyField operator+(const Field &x) const
+    {
+        LazyField r{*this};
+
+        return r += x;
+    }
+
+    Field reduce() const
+    {
+        static const Limbs FOLD{fold_constant()};
+
+        Limbs r{v};
+        Field x;
+
+        // r = h * 2^(64 N) + l = l + h * (2^(64 N) mod p) (mod p), until the top limb is 0
+        while (r[N])
+        {
+            mp_limb_t h = r[N];
+
+            r[N] = mpn_addmul_1(r.data(), FOLD.data(), N, h);
+        }
+
+        while (mpn_cmp(r.data(), Field::mod.data, N) >= 0)
+            mpn_sub_n(r.data(), r.data(), Field::mod.data, N);
+
+        for (size_t i = 0; i < N; ++i)
+            x.mont_repr.data[i] = r[i];
+
+        return x;
+    }
+
+    explicit operator Field() const { return reduce(); }
+
+    const Limbs &limbs() const { return v; }
+
+private:
+    Limbs v;
+
+    static Limbs fold_constant()
+    {
+        mpz_class p, r{1};
+        Limbs c{};
+
+        Field::mod.to_mpz(p.get_mpz_t());
+        r <<= GMP_NUMB_BITS * N;
+        r %= p;
+        mpz_export(c.data(), nullptr, -1, sizeof(mp_limb_t), 0, 0, r.get_mpz_t());
+
+        return c;
+    }
+
+    void add(const mp_limb_t *x, size_t n)
+    {
+        unsigned __int128 c = 0;
+
+        for (size_t i = 0; i < N + 1; ++i)
+        {
+            c += v[i];
+            if (i < n)
+                c += x[i];
+            v[i] = (mp_limb_t)c;
+            c >>= GMP_NUMB_BITS;
+        }
+    }
+
+    void sub(const mp_limb_t *x)
+    {
+        mp_limb_t borrow = 0;
+
+        for (size_t i = 0; i < N + 1; ++i)
+        {
+            unsigned __int128 d = (unsigned __int128)v[i] - (i < N ? x[i] : 0) - borrow;
+
+            v[i] = (mp_limb_t)d;
+            borrow = (mp_limb_t)(d >> GMP_NUMB_BITS) & 1;
+        }
+    }
+};
+
+template<typename Field, size_t n>
+std::array<LazyField<Field>, n> to_lazy(const std::array<Field, n> &x)
+{
+    std::array<LazyField<Field>, n> l;
+
+    for (size_t i = 0; i < n; ++i)
+        l[i] = x[i];
+
+    return l;
+}
+
+template<typename Field, size_t n>
+void from_lazy(std::array<Field, n> &x, const std::array<LazyField<Field>, n> &l)
+{
+    for (size_t i = 0; i < n; ++i)
+        x[i] = l[i].reduce();
+}
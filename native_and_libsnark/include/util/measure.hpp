@@ -1,10 +1,13 @@
 #pragma once
 
 #include "intrinsics.h"
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <functional>
 #include <iomanip>
 #include <iostream>
+#include <vector>
 
 template<typename T>
 void consume(T &x)
@@ -14,6 +17,26 @@ void consume(T &x)
     asm volatile("" : : "rm"(p));
 }
 
+// Timestamp counter reads for the start and the end of a timed region: the fences keep earlier
+// work out of the region, and rdtscp waits for the timed instructions to retire
+static inline uint64_t tsc_begin()
+{
+    _mm_lfence();
+    uint64_t t = __rdtsc();
+    _mm_lfence();
+
+    return t;
+}
+
+static inline uint64_t tsc_end()
+{
+    unsigned aux;
+    uint64_t t = __rdtscp(&aux);
+    _mm_lfence();
+
+    return t;
+}
+
 template<typename Fn> //
 double measure(Fn foo, size_t repeat = 1, size_t times = 1, const char *name = nullptr,
                bool output = true)
@@ -32,7 +55,7 @@ double measure(Fn foo, size_t repeat = 1, size_t times = 1, const char *name = n
 
     for (size_t i = 0; i < times; ++i)
     {
-        uint64_t c_start = __rdtsc();
+        uint64_t c_start = tsc_begin();
         auto start = clk::now();
         for (size_t j = 0; j < repeat; ++j)
         {
@@ -42,7 +65,7 @@ double measure(Fn foo, size_t repeat = 1, size_t times = 1, const char *name = n
                 foo();
         }
 
-        uint64_t clocks = __rdtsc() - c_start;
+        uint64_t clocks = tsc_end() - c_start;
         uint64_t elap = (clk::now() - start).count();
 
         double elap_ms = elap / 1'000'000.;
@@ -70,3 +93,151 @@ double measure(Fn foo, size_t repeat = 1, size_t times = 1, const char *name = n
 
     return elap_avg;
 }
+
+// Timestamp counter ticks per nanosecond, calibrated once against the steady clock
+static inline double tsc_ghz()
+{
+    static const double ghz = []
+    {
+        using clk = std::chrono::steady_clock;
+
+        auto start = clk::now();
+        uint64_t c_start = tsc_begin();
+
+        while (clk::now() - start < std::chrono::milliseconds(20))
+            ;
+
+        uint64_t clocks = tsc_end() - c_start;
+
+        return (double)clocks / std::chrono::nanoseconds(clk::now() - start).count();
+    }();
+
+    return ghz;
+}
+
+struct MeasureConfig
+{
+    size_t warmup = 3;     // untimed calls before the first sample
+    size_t samples = 15;   // timed samples
+    double target_ms = 10; // calls per sample grow until a sample takes at least this long
+    double outlier = 3.5;  // samples further than this many (normalized) MADs from the median
+                           // are dropped
+};
+
+struct Measurement
+{
+    size_t iterations = 0;  // calls per sample
+    std::vector<double> ns; // time of one call, for each kept sample
+    size_t outliers = 0;    // samples dropped
+    double median_ns = 0;
+    double mad_ns = 0; // median absolute deviation, scaled to estimate the standard deviation
+    double min_ns = 0;
+    double mean_ns = 0; // of the kept samples
+    double ci95_ns = 0; // half width of the 95% confidence interval of the mean
+    double median_cycles = 0;
+};
+
+static inline double median_of(std::vector<double> x)
+{
+    if (x.empty())
+        return 0;
+
+    std::sort(x.begin(), x.end());
+
+    return x.size() % 2 ? x[x.size() / 2] : (x[x.size() / 2 - 1] + x[x.size() / 2]) / 2;
+}
+
+/*
+Times foo() after some warmup calls, over a number of samples of the same number of calls each,
+and summarizes them by median and MAD. If reset is given, it runs before every call and outside
+of the timed region (each call is then timed on its own), e.g. to restore the input of a hash
+that works in place.
+*/
+template<typename Fn, typename Reset = std::nullptr_t>
+Measurement measure_samples(Fn foo, const MeasureConfig &cfg = {}, Reset reset = nullptr)
+{
+    static constexpr bool RESET = !std::is_same_v<Reset, std::nullptr_t>;
+
+    // Clocks of n consecutive calls
+    auto run = [&](size_t n)
+    {
+        if constexpr (RESET)
+        {
+            uint64_t clocks = 0;
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                reset();
+                uint64_t c_start = tsc_begin();
+                foo();
+                clocks += tsc_end() - c_start;
+            }
+
+            return clocks;
+        }
+        else
+        {
+            uint64_t c_start = tsc_begin();
+
+            for (size_t i = 0; i < n; ++i)
+                foo();
+
+            return tsc_end() - c_start;
+        }
+    };
+
+    const double ghz = tsc_ghz();
+    const double target = cfg.target_ms * 1'000'000 * ghz;
+    Measurement m;
+
+    run(cfg.warmup);
+
+    // Adapt the calls per sample to the target time, doubling from a single call
+    m.iterations = 1;
+    for (uint64_t clocks = run(1); clocks < target && m.iterations < (1ULL << 30);)
+    {
+        m.iterations *= 2;
+        clocks = run(m.iterations);
+    }
+
+    std::vector<double> cycles;
+
+    for (size_t i = 0; i < cfg.samples; ++i)
+        cycles.push_back((double)run(m.iterations) / m.iterations);
+
+    double median = median_of(cycles);
+    std::vector<double> dev;
+
+    for (auto &&x : cycles)
+        dev.push_back(std::abs(x - median));
+
+    // 1.4826 * MAD estimates the standard deviation of normally distributed samples
+    double mad = 1.4826 * median_of(dev);
+
+    for (auto &&x : cycles)
+    {
+        if (mad > 0 && std::abs(x - median) > cfg.outlier * mad)
+            ++m.outliers;
+        else
+            m.ns.push_back(x / ghz);
+    }
+
+    m.median_cycles = median;
+    m.median_ns = median / ghz;
+    m.mad_ns = mad / ghz;
+
+    if (m.ns.empty())
+        return m;
+
+    double var = 0;
+
+    m.min_ns = *std::min_element(m.ns.begin(), m.ns.end());
+    for (auto &&x : m.ns)
+        m.mean_ns += x / m.ns.size();
+    for (auto &&x : m.ns)
+        var += (x - m.mean_ns) * (x - m.mean_ns);
+    if (m.ns.size() > 1)
+        m.ci95_ns = 1.96 * std::sqrt(var / (m.ns.size() - 1) / m.ns.size());
+
+    return m;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <fcntl.h>
+#include <istream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+class MmapStreamBuf : public std::streambuf
+{
+    /* MmapStreamBuf
+    * Read-only stream buffer over a memory mapped file.
+    * The get area points straight into the mapping, so deserializing from it does not copy the
+    * file into an intermediate buffer, and pages are faulted in lazily by the kernel (or served
+    * from the page cache on warm starts).
+    */
+private:
+    char *data = nullptr;
+    size_t sz = 0;
+
+public:
+    MmapStreamBuf() = default;
+    MmapStreamBuf(const MmapStreamBuf &) = delete;
+    MmapStreamBuf &operator=(const MmapStreamBuf &) = delete;
+
+    explicit MmapStreamBuf(const std::string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+
+        if (fd < 0)
+            return;
+
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (p != MAP_FAILED)
+            {
+                data = (char *)p;
+                sz = st.st_size;
+                // keys are read front to back exactly once
+                madvise(data, sz, MADV_SEQUENTIAL);
+                madvise(data, sz, MADV_WILLNEED);
+                setg(data, data, data + sz);
+            }
+        }
+
+        ::close(fd);
+    }
+
+    ~MmapStreamBuf()
+    {
+        if (data)
+            munmap(data, sz);
+    }
+
+    bool is_open() const { return data != nullptr; }
+
+    size_t size() const { return sz; }
+};
+
+class MmapIStream : public std::istream
+{
+private:
+    MmapStreamBuf buf;
+
+public:
+    explicit MmapIStream(const std::string &path) : std::istream{nullptr}, buf{path}
+    {
+        rdbuf(&buf);
+
+        if (!buf.is_open())
+            setstate(std::ios::failbit);
+    }
+
+    bool is_open() const { return buf.is_open(); }
+};
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <linux/perf_event.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <utility>
+
+enum PerfEvent : size_t
+{
+    PERF_INSTRUCTIONS,
+    PERF_CYCLES,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_EVENTS_N
+};
+
+struct PerfCounts
+{
+    static constexpr const char *NAMES[PERF_EVENTS_N] = {"instructions", "cycles", "l1d_misses",
+                                                         "llc_misses", "branch_misses"};
+
+    static constexpr double NONE = std::numeric_limits<double>::quiet_NaN();
+
+    // NONE for the events which could not be counted
+    std::array<double, PERF_EVENTS_N> value{NONE, NONE, NONE, NONE, NONE};
+    // Number of nodes (hash calls) the values are divided by, 0 if they are totals
+    size_t nodes = 0;
+
+    double operator[](size_t i) const { return value[i]; }
+
+    double ipc() const { return value[PERF_INSTRUCTIONS] / value[PERF_CYCLES]; }
+
+    // Rates per node, out of the totals of n nodes
+    PerfCounts per_node(size_t n) const
+    {
+        PerfCounts c;
+
+        for (size_t i = 0; i < PERF_EVENTS_N; ++i)
+            c.value[i] = value[i] / n;
+        c.nodes = n;
+
+        return c;
+    }
+};
+
+class PerfCounters
+{
+    /* PerfCounters
+    * Hardware counters of the calling thread (user space only) read through perf_event_open.
+    * Every event is opened on its own, so the ones the CPU or the kernel do not support are left
+    * out (NONE) instead of disabling the rest; if none can be opened, e.g. in containers or with
+    * a restrictive perf_event_paranoid, available() is false and count() only runs the code.
+    * Values are scaled by enabled/running time when the kernel multiplexes the counters.
+    * With MULTICORE, work done by the other OpenMP threads is not counted.
+    */
+public:
+    PerfCounters()
+    {
+        static constexpr uint64_t L1D_READ_MISS = PERF_COUNT_HW_CACHE_L1D |
+                                                  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+        static constexpr std::array<std::pair<uint32_t, uint64_t>, PERF_EVENTS_N> EVENTS{{
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HW_CACHE, L1D_READ_MISS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        }};
+
+        for (size_t i = 0; i < PERF_EVENTS_N; ++i)
+        {
+            perf_event_attr attr;
+
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = EVENTS[i].first;
+            attr.config = EVENTS[i].second;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            fd[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+
+            if (fd[i] < 0 && error.empty())
+                error = std::strerror(errno);
+        }
+    }
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    ~PerfCounters()
+    {
+        for (auto &&x : fd)
+            if (x >= 0)
+                ::close(x);
+    }
+
+    bool available() const
+    {
+        for (auto &&x : fd)
+            if (x >= 0)
+                return true;
+
+        return false;
+    }
+
+    // Whether the events are counted, with the error of the first one which could not be opened
+    std::string summary() const
+    {
+        if (error.empty())
+            return "available";
+
+        return std::string(available() ? "partial (" : "unavailable (") + error + ")";
+    }
+
+    void start()
+    {
+        for (auto &&x : fd)
+            if (x >= 0)
+            {
+                ioctl(x, PERF_EVENT_IOC_RESET, 0);
+                ioctl(x, PERF_EVENT_IOC_ENABLE, 0);
+            }
+    }
+
+    PerfCounts stop()
+    {
+        PerfCounts c;
+
+        for (auto &&x : fd)
+            if (x >= 0)
+                ioctl(x, PERF_EVENT_IOC_DISABLE, 0);
+
+        for (size_t i = 0; i < PERF_EVENTS_N; ++i)
+        {
+            uint64_t buf[3]; // value, time enabled, time running
+
+            if (fd[i] < 0 || ::read(fd[i], buf, sizeof(buf)) != sizeof(buf) || !buf[2])
+                continue;
+
+            c.value[i] = (double)buf[0] * buf[1] / buf[2];
+        }
+
+        return c;
+    }
+
+    template<typename Fn>
+    PerfCounts count(Fn foo)
+    {
+        start();
+        foo();
+
+        return stop();
+    }
+
+private:
+    std::array<int, PERF_EVENTS_N> fd;
+    std::string error;
+};
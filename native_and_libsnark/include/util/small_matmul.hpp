@@ -0,0 +1,184 @@
+#pragma once
+
+#include <algorithm>
+#include "util/lazy_field.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// Constants up to this many bits are applied with additions and doublings, wider ones (or the
+// ones which are not integers at all) with a field multiplication
+static constexpr size_t SMALL_CONSTANT_BITS = 8;
+
+constexpr size_t constant_bits(uint64_t c)
+{
+    size_t bits = 0;
+
+    for (; c; c >>= 1)
+        ++bits;
+
+    return bits;
+}
+
+constexpr bool small_constant(uint64_t c)
+{
+    return constant_bits(c) <= SMALL_CONSTANT_BITS;
+}
+
+template<size_t n>
+constexpr std::array<uint64_t, n> constant_iota(uint64_t first)
+{
+    std::array<uint64_t, n> c{};
+
+    for (size_t i = 0; i < n; ++i)
+        c[i] = first + i;
+
+    return c;
+}
+
+template<size_t n, typename Fn>
+constexpr void static_for(Fn &&fn)
+{
+    // fn(std::integral_constant<size_t, i>{}) for i = 0, ..., n - 1, unrolled at compile time
+    [&]<size_t... i>(std::index_sequence<i...>)
+    {
+        (fn(std::integral_constant<size_t, i>{}), ...);
+    }
+    (std::make_index_sequence<n>{});
+}
+
+/*
+Computes acc += c * x with an addition chain: one doubling per bit of c but the top one, one
+addition per bit set. The doublings are done in the type of acc, so a LazyField accumulator
+keeps the whole chain unreduced.
+*/
+template<uint64_t c, typename Acc, typename Field>
+void small_mul_add(Acc &acc, const Field &x)
+{
+    if constexpr (c == 1)
+        acc += x;
+    else if constexpr (!small_constant(c))
+    {
+        static const Field k(c);
+
+        acc += k * x;
+    }
+    else if constexpr (c != 0)
+    {
+        Acc p{x};
+
+        static_for<constant_bits(c)>(
+            [&](auto b)
+            {
+                if constexpr (c >> b & 1)
+                    acc += p;
+                if constexpr (b + 1 < constant_bits(c))
+                    p += p;
+            });
+    }
+}
+
+/*
+Computes x *= c with an addition chain (left to right, so that only doublings of x and additions
+of its initial value are needed). Also applies to a LazyField.
+*/
+template<uint64_t c, typename Field>
+void small_mul(Field &x)
+{
+    static_assert(c != 0, "Multiplication by zero");
+
+    if constexpr (!small_constant(c))
+    {
+        static const Field k(c);
+
+        x *= k;
+    }
+    else if constexpr (c != 1)
+    {
+        static constexpr size_t BITS = constant_bits(c);
+
+        Field t{x};
+
+        static_for<BITS - 1>(
+            [&](auto b)
+            {
+                x += x;
+                if constexpr (c >> (BITS - 2 - b) & 1)
+                    x += t;
+            });
+    }
+}
+
+template<size_t n, const std::array<uint64_t, n * n> &M>
+class SmallMatmul
+{
+    /* SmallMatmul
+    * Matrix-vector product with a matrix of integer constants known at compile time, fully unrolled
+    * into additions and doublings: every column j keeps one running doubling of x[j], which is
+    * added to the rows whose entry has the corresponding bit set. Entries which are not small
+    * (see SMALL_CONSTANT_BITS) fall back to a multiplication by the constant, zeros cost nothing.
+    * Sums are accumulated in LazyField and reduced once per output.
+    * For the usual MDS/circulant matrices of the hashes (entries up to t or t^2) this replaces the
+    * t^2 field multiplications of a generic product with a few additions each.
+    */
+public:
+    static constexpr size_t N = n;
+
+    template<typename Field>
+    static void apply(std::array<Field, n> &x)
+    {
+        std::array<LazyField<Field>, n> y;
+
+        static_for<n>([&](auto j) { column<j>(x, y); });
+
+        from_lazy(x, y);
+    }
+
+private:
+    // Doublings of x[j] needed by the small entries of column j
+    static constexpr size_t column_bits(size_t j)
+    {
+        size_t bits = 0;
+
+        for (size_t i = 0; i < n; ++i)
+            if (small_constant(M[i * n + j]))
+                bits = std::max(bits, constant_bits(M[i * n + j]));
+
+        return bits;
+    }
+
+    template<size_t j, typename Field>
+    static void column(const std::array<Field, n> &x, std::array<LazyField<Field>, n> &y)
+    {
+        static constexpr size_t BITS = column_bits(j);
+
+        LazyField<Field> p{x[j]};
+
+        static_for<BITS>(
+            [&](auto b)
+            {
+                static_for<n>(
+                    [&](auto i)
+                    {
+                        static constexpr uint64_t m = M[i * n + j];
+
+                        if constexpr (small_constant(m) && (m >> b & 1))
+                            y[i] += p;
+                    });
+
+                if constexpr (b + 1 < BITS)
+                    p += p;
+            });
+
+        static_for<n>(
+            [&](auto i)
+            {
+                static constexpr uint64_t m = M[i * n + j];
+
+                if constexpr (!small_constant(m))
+                    small_mul_add<m>(y[i], x[j]);
+            });
+    }
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+template<typename Field, size_t lanes>
+class TraceSink
+{
+    /* TraceSink
+    * Records the intermediate values of a permutation, one buffer per lane. Every lane is filled in
+    * the order the corresponding gadget allocates its variables, so a gadget can copy a lane
+    * straight into its protoboard assignment.
+    */
+public:
+    static constexpr size_t LANES = lanes;
+
+    // Make room for n values on lane k, and rewind it
+    void resize(size_t k, size_t n)
+    {
+        lane[k].resize(n);
+        pos[k] = 0;
+    }
+
+    void push(size_t k, const Field &x) { lane[k][pos[k]++] = x; }
+
+    // Next n values of lane k, for values which are not computed in order
+    Field *take(size_t k, size_t n)
+    {
+        Field *p = lane[k].data() + pos[k];
+
+        pos[k] += n;
+
+        return p;
+    }
+
+    const Field *data(size_t k) const { return lane[k].data(); }
+
+private:
+    std::array<std::vector<Field>, LANES> lane;
+    std::array<size_t, LANES> pos{};
+};
@@ -5,6 +5,7 @@
 #include "gadget/hash/mimc/mimc512f2k_gadget.hpp"
 #include "gadget/hash/mimc/mimc512f_gadget.hpp"
 #include "gadget/hash/poseidon/poseidon_gadget.hpp"
+#include "gadget/hash/poseidon/poseidon_opt_gadget.hpp"
 #include "gadget/hash/poseidon2/poseidon2_gadget.hpp"
 #include "gadget/hash/rescue/rescue_gadget.hpp"
 #include "gadget/hash/sha256/sha256_gadget_pp.hpp"
@@ -20,7 +21,9 @@
 
 #include "r1cs/r1cs_ppzksnark_pp.hpp"
 #include "tree/mtree.hpp"
+#include "util/bench_output.hpp"
 #include "util/measure.hpp"
+#include "util/perf_counters.hpp"
 
 #include <filesystem>
 #include <fstream>
@@ -33,6 +36,19 @@ static constexpr size_t MIN_HEIGHT = 6;
 static constexpr size_t MAX_HEIGHT = 30 + 1; // the +1 is to highlight that the bound is exclusive
 static constexpr size_t STEP_HEIGHT = 6;
 static constexpr int NUM_THREADS = 1;
+// Log the time of every step (tree, gadget, constraints, witness, key, proof, verification) and
+// the phases of the prover, instead of the proof time only
+static constexpr bool PHASES = true;
+// Count instructions, cycles, cache and branch misses of every step, per node of the path, in the
+// structured output; the log has those of the witness generation (skipped if perf_event_open is
+// not available)
+static constexpr bool COUNTERS = true;
+// Batch proving: number of independent proofs per batch and tree height
+static constexpr size_t BATCH_SIZE = 64;
+static constexpr size_t BATCH_HEIGHT = 12;
+// Proving/verification keys are cached here, keyed by circuit shape; delete the directory to force
+// key generation
+static const std::string KEYS_PATH = "./keys";
 
 namespace fs = std::filesystem;
 
@@ -40,17 +56,70 @@ using ppT = libsnark::default_r1cs_ppzksnark_pp;
 using FieldT = libff::Fr<ppT>;
 
 static std::ofstream log_file;
-static std::string table_header = std::string("Height\t") + //std::string("Tree\t") +
-                                  //std::string("Gadget\t") + std::string("Constraint\t") +
-                                  //std::string("Witness\t") + std::string("Key\t") +
-                                  std::string("Proof\n"); // + std::string("Verify\n");
+static std::unique_ptr<BenchOutput> bench_output;
+static int threads = 1;
+static std::unique_ptr<PerfCounters> counters;
+static const std::string table_header{[]
+                                      {
+                                          if (!PHASES)
+                                              return std::string("Height\tProof");
+
+                                          std::string s{"Height\tTree\tGadget\tConstraint\t"
+                                                        "Witness\tKey\tProof\tVerify"};
+
+                                          for (auto &&x : r1cs_ppzksnark_prover_phases::NAMES)
+                                              s += std::string("\t") + x;
+
+                                          return s;
+                                      }()};
+static const std::string counters_header = std::string("\tInstr/node\tCycles/node\tIPC\t") +
+                                           std::string("L1D miss/node\tLLC miss/node\t") +
+                                           std::string("Branch miss/node");
+
+// Time of a single call of foo, and its hardware counters per node if they are available
+template<typename Fn>
+double measure_counted(Fn foo, size_t nodes, PerfCounts &count)
+{
+    double elap = 0;
 
-template<size_t height, typename GadHash>
-bool bench_mtree(size_t trans_idx = 0)
+    if (!counters)
+        return measure(foo, 1, 1, nullptr, false);
+
+    count = counters->count([&]() { elap = measure(foo, 1, 1, nullptr, false); }).per_node(nodes);
+
+    return elap;
+}
+
+// Fill trans and the siblings with the path of a (randomly generated) tree
+template<typename Hash, typename Tree, typename DigVar, typename Level>
+void assign_path(const Tree &tree, const std::vector<uint8_t> &data, DigVar &trans,
+                 std::vector<Level> &other, size_t trans_idx)
+{
+    trans.generate_r1cs_witness(tree.get_node(0)->get_digest());
+
+    for (size_t i = 0, idx = trans_idx; i < other.size(); ++i, idx /= Tree::ARITY)
+    {
+        size_t j = idx % Tree::ARITY;
+        size_t off = Hash::BLOCK_SIZE + i * (Tree::ARITY - 1) * Hash::DIGEST_SIZE;
+
+        for (size_t k = 0; k < j; ++k)
+            other[i][k].generate_r1cs_witness(data.data() + off + k * Hash::DIGEST_SIZE,
+                                              Hash::DIGEST_SIZE);
+
+        other[i][j].generate_r1cs_witness(tree.get_node(i)->get_digest());
+
+        for (size_t k = j + 1; k < Tree::ARITY; ++k)
+            other[i][k].generate_r1cs_witness(data.data() + off + (k - 1) * Hash::DIGEST_SIZE,
+                                              Hash::DIGEST_SIZE);
+    }
+}
+
+template<size_t height, typename GadHash, MTreeSelector selector>
+bool bench_mtree(const char *name, size_t trans_idx = 0)
 {
     static constexpr size_t HEIGHT = height;
 
-    using GadTree = MTreeGadget<height, GadHash>;
+    using GadTree = MTreeGadget<height, GadHash, selector>;
     using DigVar = typename GadTree::DigVar;
     using Level = typename GadTree::Level;
     using Hash = typename GadHash::Hash;
@@ -65,16 +134,31 @@ bool bench_mtree(size_t trans_idx = 0)
     std::generate(data.begin(), data.end(), std::ref(rng));
     Tree tree;
 
+    // Every step hashes (or proves) the HEIGHT nodes of a path
+    static constexpr size_t NODES_N = Tree::NODES_N;
+
+    PerfCounts count;
+    PerfCounts witness_count;
+
+    // Each step goes to the structured output, and to the log table if PHASES is set
+    auto log_step = [&](const char *phase, const std::vector<double> &samples,
+                        const PerfCounts &c = {})
+    {
+        BenchStats stats{BenchStats::of(samples)};
+
+        bench_output->record<Hash>(name, HEIGHT, threads, phase, stats, c);
+
+        return stats.mean;
+    };
+
     log_file << height << '\t';
     log_file.flush();
 
     // Build tree
-    elap = measure(
-        [&]() {
-            tree = Tree{data.begin(), data.end()};
-        },
-        1, 1, "Tree Generation", false);
-    //log_file << elap << '\t';
+    elap = measure_counted([&]() { tree = Tree{data.begin(), data.end()}; }, NODES_N, count);
+    elap = log_step("Tree", {elap}, count);
+    if (PHASES)
+        log_file << elap << '\t';
     log_file.flush();
 
     // Test Gadget
@@ -89,16 +173,18 @@ bool bench_mtree(size_t trans_idx = 0)
         other.emplace_back(make_uniform_array<Level>(pb, DIGEST_VARS, FMT("other_%llu", i)));
 
     // Gadget construction
-    elap = measure(
-        [&]() { gadget = std::make_unique<GadTree>(pb, out, trans, other, FMT("merkle_tree")); }, 1,
-        1, "Gadget construction", false);
-    //log_file << elap << '\t';
+    elap = measure_counted(
+        [&]() { gadget = std::make_unique<GadTree>(pb, out, trans, other, FMT("merkle_tree")); },
+        NODES_N, count);
+    elap = log_step("Gadget", {elap}, count);
+    if (PHASES)
+        log_file << elap << '\t';
     log_file.flush();
 
     pb.set_input_sizes(DIGEST_VARS);
 
     // Constraint generation
-    elap = measure(
+    elap = measure_counted(
         [&]()
         {
             out.generate_r1cs_constraints();
@@ -108,70 +194,187 @@ bool bench_mtree(size_t trans_idx = 0)
                     other[i][j].generate_r1cs_constraints();
             gadget->generate_r1cs_constraints();
         },
-        1, 1, "Constraint generation", false);
-    //log_file << elap << '\t';
+        NODES_N, count);
+    elap = log_step("Constraint", {elap}, count);
+    if (PHASES)
+        log_file << elap << '\t';
     log_file.flush();
 
-    trans.generate_r1cs_witness(tree.get_node(0)->get_digest());
-
-    for (size_t i = 0, idx = trans_idx; i < other.size(); ++i, idx /= Tree::ARITY)
-    {
-        size_t j = idx % Tree::ARITY;
-        size_t off = Hash::BLOCK_SIZE + i * (Tree::ARITY - 1) * Hash::DIGEST_SIZE;
-
-        for (size_t k = 0; k < j; ++k)
-            other[i][k].generate_r1cs_witness(data.data() + off + k * Hash::DIGEST_SIZE,
-                                              Hash::DIGEST_SIZE);
-
-        other[i][j].generate_r1cs_witness(tree.get_node(i)->get_digest());
-
-        for (size_t k = j + 1; k < Tree::ARITY; ++k)
-            other[i][k].generate_r1cs_witness(data.data() + off + (k - 1) * Hash::DIGEST_SIZE,
-                                              Hash::DIGEST_SIZE);
-    }
+    assign_path<Hash>(tree, data, trans, other, trans_idx);
 
     // Witness generation
-    elap = measure([&]() { gadget->generate_r1cs_witness(trans_idx); }, 1, 1, "Witness generation",
-                   false);
-    //log_file << elap << '\t';
+    elap = measure_counted([&]() { gadget->generate_r1cs_witness(trans_idx); }, NODES_N,
+                           witness_count);
+    elap = log_step("Witness", {elap}, witness_count);
+    if (PHASES)
+        log_file << elap << '\t';
     log_file.flush();
 
-    // Key generation
+    // Key generation (or loading, on warm starts)
     r1cs_ppzksnark_keypair<ppT> keypair;
-    elap = measure(
-        [&]() { keypair = libsnark::r1cs_ppzksnark_generator<ppT>(pb.get_constraint_system()); }, 1,
-        1, "Key generation", false);
-    //log_file << elap << '\t';
+    elap = measure_counted(
+        [&]()
+        {
+            keypair = r1cs_ppzksnark_cached_generator<ppT, GadTree>(KEYS_PATH, HEIGHT,
+                                                                    pb.get_constraint_system());
+        },
+        NODES_N, count);
+    elap = log_step("Key", {elap}, count);
+    if (PHASES)
+        log_file << elap << '\t';
     log_file.flush();
 
     // Proof generation
+    static constexpr size_t PROOFS_N = 4;
+
     libsnark::r1cs_ppzksnark_proof<ppT> proof;
-    elap = measure(
-        [&]()
-        {
-            proof = libsnark::r1cs_ppzksnark_prover<ppT>(keypair.pk, pb.primary_input(),
-                                                         pb.auxiliary_input());
-        },
-        1, 4, "Proof generation", false);
-    log_file << elap << '\n';
+    r1cs_ppzksnark_prover_phases phases;
+    std::vector<double> proof_ms;
+    std::array<std::vector<double>, r1cs_ppzksnark_prover_phases::PHASES_N> phases_ms;
+
+    // counters of the last proof
+    for (size_t i = 0; i < PROOFS_N; ++i)
+    {
+        proof_ms.push_back(measure_counted(
+            [&]()
+            {
+                proof = r1cs_ppzksnark_profiled_prover<ppT>(keypair.pk, pb.primary_input(),
+                                                            pb.auxiliary_input(), phases);
+            },
+            NODES_N, count));
+
+        for (size_t j = 0; j < phases.ms.size(); ++j)
+            phases_ms[j].push_back(phases.ms[j]);
+    }
+
+    log_file << log_step("Proof", proof_ms, count) << (PHASES ? '\t' : '\n');
     log_file.flush();
 
     // Proof Verification
     bool result;
-    elap = measure(
+    elap = measure_counted(
         [&]()
         {
             result = libsnark::r1cs_ppzksnark_verifier_strong_IC<ppT>(keypair.vk,
                                                                       pb.primary_input(), proof);
         },
-        1, 1, "Proof verification", false);
-    //log_file << elap << '\n';
+        NODES_N, count);
+
+    elap = log_step("Verify", {elap}, count);
+
+    for (size_t j = 0; j < phases_ms.size(); ++j)
+        phases.ms[j] = log_step(r1cs_ppzksnark_prover_phases::NAMES[j], phases_ms[j]);
+
+    if (PHASES)
+    {
+        log_file << elap;
+        for (auto &&x : phases.ms)
+            log_file << '\t' << x;
+        if (counters)
+        {
+            for (size_t i : {PERF_INSTRUCTIONS, PERF_CYCLES})
+                log_file << '\t' << witness_count[i];
+            log_file << '\t' << witness_count.ipc();
+            for (size_t i : {PERF_L1D_MISSES, PERF_LLC_MISSES, PERF_BRANCH_MISSES})
+                log_file << '\t' << witness_count[i];
+        }
+        log_file << '\n';
+    }
     log_file.flush();
 
 
     return result;
 }
 
+template<size_t height, typename GadHash>
+bool bench_batch(const char *name)
+{
+    static constexpr size_t HEIGHT = height;
+
+    using GadTree = MTreeGadget<height, GadHash>;
+    using DigVar = typename GadTree::DigVar;
+    using Level = typename GadTree::Level;
+    using Hash = typename GadHash::Hash;
+    using Tree = MTreePath<HEIGHT, Hash>;
+
+    static constexpr size_t DIGEST_VARS = GadHash::DIGEST_VARS;
+
+    static std::mt19937 rng{std::random_device{}()};
+
+    // One circuit...
+    libsnark::protoboard<FieldT> pb;
+
+    DigVar out{pb, DIGEST_VARS, FMT("out")};
+    DigVar trans{pb, DIGEST_VARS, FMT("trans")};
+    std::vector<Level> other;
+
+    for (size_t i = 0; i < HEIGHT - 1; ++i)
+        other.emplace_back(make_uniform_array<Level>(pb, DIGEST_VARS, FMT("other_%llu", i)));
+
+    GadTree gadget{pb, out, trans, other, FMT("merkle_tree")};
+
+    pb.set_input_sizes(DIGEST_VARS);
+    out.generate_r1cs_constraints();
+    trans.generate_r1cs_constraints();
+    for (size_t i = 0; i < other.size(); ++i)
+        for (size_t j = 0; j < other[i].size(); ++j)
+            other[i][j].generate_r1cs_constraints();
+    gadget.generate_r1cs_constraints();
+
+    // ...many independent witnesses
+    std::vector<libsnark::r1cs_ppzksnark_primary_input<ppT>> primary(BATCH_SIZE);
+    std::vector<libsnark::r1cs_ppzksnark_auxiliary_input<ppT>> auxiliary(BATCH_SIZE);
+    std::vector<uint8_t> data(Tree::INPUT_SIZE);
+
+    for (size_t n = 0; n < BATCH_SIZE; ++n)
+    {
+        size_t trans_idx = rng() % Tree::LEAVES_N;
+
+        std::generate(data.begin(), data.end(), std::ref(rng));
+
+        Tree tree{data.begin(), data.end(), trans_idx};
+
+        assign_path<Hash>(tree, data, trans, other, trans_idx);
+        gadget.generate_r1cs_witness(trans_idx);
+
+        primary[n] = pb.primary_input();
+        auxiliary[n] = pb.auxiliary_input();
+    }
+
+    auto keypair = r1cs_ppzksnark_cached_generator<ppT, GadTree>(KEYS_PATH, HEIGHT,
+                                                                 pb.get_constraint_system());
+
+    log_file << name << " (" << GadTree::ARITY << ":1), height = " << HEIGHT
+             << ", batch = " << BATCH_SIZE << '\n';
+    log_file << "Threads\tProofs/s\n";
+
+    std::vector<libsnark::r1cs_ppzksnark_proof<ppT>> proofs;
+
+    for (int pool = 1; pool <= omp_get_num_procs(); pool *= 2)
+    {
+        double elap = measure(
+            [&]()
+            {
+                proofs = r1cs_ppzksnark_batch_prover<ppT>(keypair.pk, primary, auxiliary, pool);
+            },
+            1, 1, "Batch proof generation", false);
+
+        log_file << pool << '\t' << BATCH_SIZE * 1000. / elap << '\n';
+        log_file.flush();
+        bench_output->record<Hash>(name, HEIGHT, pool, "Batch proof", BenchStats::of({elap}));
+    }
+
+    log_file << '\n';
+
+    bool result = true;
+
+    for (size_t n = 0; n < BATCH_SIZE; ++n)
+        result &= libsnark::r1cs_ppzksnark_verifier_strong_IC<ppT>(keypair.vk, primary[n],
+                                                                   proofs[n]);
+
+    return result;
+}
+
 constexpr size_t countr_zero(size_t x)
 {
     size_t result = 0;
@@ -184,28 +387,29 @@ constexpr size_t countr_zero(size_t x)
     return result;
 }
 
-template<size_t first, size_t last, typename GadHash>
+template<size_t first, size_t last, typename GadHash, MTreeSelector selector>
 void bench_range(const char *name)
 {
     static constexpr size_t ARITY = GadHash::BLOCK_SIZE / GadHash::DIGEST_SIZE;
 
     if constexpr (first < last)
     {
-        bench_mtree<first / countr_zero(ARITY), GadHash>();
+        bench_mtree<first / countr_zero(ARITY), GadHash, selector>(name);
 
-        bench_range<first + STEP_HEIGHT, last, GadHash>(name);
+        bench_range<first + STEP_HEIGHT, last, GadHash, selector>(name);
     }
 }
 
-template<typename GadHash>
+template<typename GadHash, MTreeSelector selector = MTreeSelector::ONEHOT>
 void bench(const char *name)
 {
     static constexpr size_t RATIO = GadHash::BLOCK_SIZE / GadHash::DIGEST_SIZE;
 
     log_file << name << " (" << RATIO << ":1), r = " << GadHash::Hash::ROUNDS_N
-             << ", c = " << GadHash::size() << '\n';
-    log_file << table_header;
-    bench_range<MIN_HEIGHT, MAX_HEIGHT, GadHash>(name);
+             << ", c = " << GadHash::constraints()
+             << ", level c = " << MTreeGadget<2, GadHash, selector>::constraints() << '\n';
+    log_file << table_header << (PHASES && counters ? counters_header : "") << '\n';
+    bench_range<MIN_HEIGHT, MAX_HEIGHT, GadHash, selector>(name);
     log_file << '\n';
 }
 
@@ -218,6 +422,8 @@ int main()
     std::string log_file_name = std::string("./log/benchmark_mtree_") + timestamp +
                                 std::string(".log");
     log_file.open(log_file_name);
+    bench_output = std::make_unique<BenchOutput>(std::string("./log/benchmark_mtree_") +
+                                                 timestamp);
 
     std::cout << "Logging to " << log_file_name << "...\n";
 
@@ -238,16 +444,26 @@ int main()
 
 #ifdef MULTICORE
     omp_set_num_threads(NUM_THREADS);
+    threads = omp_get_max_threads();
     log_file << "Threads:\t" << omp_get_max_threads() << "\n";
 #else
     log_file << "Threads:\t1\n";
 #endif
 
+    if (COUNTERS)
+    {
+        counters = std::make_unique<PerfCounters>();
+        log_file << "Counters:\t" << counters->summary() << "\n";
+
+        if (!counters->available())
+            counters.reset();
+    }
+
     /**
     To benchmark some permutation gadget over a merkle tree, follow the syntax below:
 
     log_file << "Permutation_Name\n";
-    log_file << table_header;
+    log_file << table_header << '\n';
     bench_range<min_tree_height, max_tree_height, PermutationGadget>("Permutation_Name"); 
     lof_file << "\n";
 
@@ -278,6 +494,10 @@ int main()
     bench<PoseidonGadget<Poseidon<FieldT, 4, 1, 4, 56>>>("Poseidon");
     bench<PoseidonGadget<Poseidon<FieldT, 8, 1, 4, 56>>>("Poseidon");
 
+    bench<PoseidonOptGadget<Poseidon<FieldT, 2, 1, 4, 55>>>("Poseidon (sparse)");
+    bench<PoseidonOptGadget<Poseidon<FieldT, 4, 1, 4, 56>>>("Poseidon (sparse)");
+    bench<PoseidonOptGadget<Poseidon<FieldT, 8, 1, 4, 56>>>("Poseidon (sparse)");
+
     bench<Poseidon2Gadget<Poseidon2<FieldT, 2, 4, 55>>>("Poseidon2");
     bench<Poseidon2Gadget<Poseidon2<FieldT, 4, 4, 56>>>("Poseidon2");
     bench<Poseidon2Gadget<Poseidon2<FieldT, 8, 4, 56>>>("Poseidon2");
@@ -288,7 +508,22 @@ int main()
 
     bench<Sha256Gadget<FieldT>>("SHA-256");
 
+    // Position selection: index bits and multiplexer trees instead of one-hot flags
+    bench<ArionGadget<Arion<FieldT, 2, 1, 6>>, MTreeSelector::MUX>("Arion (mux)");
+    bench<ArionGadget<Arion<FieldT, 4, 1, 5>>, MTreeSelector::MUX>("Arion (mux)");
+    bench<ArionGadget<Arion<FieldT, 8, 1, 4>>, MTreeSelector::MUX>("Arion (mux)");
+
+    bench<Sha256Gadget<FieldT>, MTreeSelector::MUX>("SHA-256 (mux)");
+
+    // Throughput of independent proofs on a thread pool sharing one proving key
+    log_file << "Batch proving\n";
+    bench_batch<BATCH_HEIGHT, ArionGadget<Arion<FieldT, 2, 1, 6>>>("Arion");
+    bench_batch<BATCH_HEIGHT / 2, ArionGadget<Arion<FieldT, 4, 1, 5>>>("Arion");
+    bench_batch<BATCH_HEIGHT, PoseidonGadget<Poseidon<FieldT, 2, 1, 4, 55>>>("Poseidon");
+
     log_file.close();
+    bench_output.reset();
+    counters.reset();
 
     return 0;
 }
@@ -0,0 +1,180 @@
+#include "gadget/hash/arion/arion_gadget.hpp"
+#include "gadget/hash/griffin/griffin_gadget.hpp"
+#include "gadget/hash/poseidon/poseidon_gadget.hpp"
+
+#include "hash/arion/arion.hpp"
+#include "hash/griffin/griffin.hpp"
+#include "hash/poseidon/poseidon.hpp"
+
+#include "util/array_utils.hpp"
+#include "util/measure.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <libff/common/default_types/ec_pp.hpp>
+#include <libsnark/common/default_types/r1cs_ppzksnark_pp.hpp>
+#include <libsnark/zk_proof_systems/ppzksnark/r1cs_ppzksnark/r1cs_ppzksnark.hpp>
+#include <string>
+
+// Independent permutations proven together, so that proving times are not dominated by noise
+static constexpr size_t HASHES_N = 64;
+// Maximum terms of a linear combination before it is materialized, 0 never materializes
+static constexpr size_t MAX_TERMS[] = {0, 32, 16, 8, 4, 2};
+static constexpr int NUM_THREADS = 1;
+
+namespace fs = std::filesystem;
+
+using ppT = libsnark::default_r1cs_ppzksnark_pp;
+using FieldT = libff::Fr<ppT>;
+
+static std::ofstream log_file;
+static std::string table_header = std::string("Max terms\t") + std::string("Constraints\t") +
+                                  std::string("Variables\t") + std::string("Nonzeros\t") +
+                                  std::string("Witness\t") + std::string("Proof\t") +
+                                  std::string("Satisfied\n");
+
+template<typename GadHash>
+void bench_terms(size_t max_terms)
+{
+    using DigVar = typename GadHash::DigVar;
+    using BlockVar = typename GadHash::BlockVar;
+    using Hash = typename GadHash::Hash;
+
+    static constexpr size_t DIGEST_VARS = GadHash::DIGEST_VARS;
+
+    static std::mt19937 rng{std::random_device{}()};
+
+    double elap = 0;
+    size_t terms = 0;
+    std::vector<uint8_t> data(HASHES_N * Hash::BLOCK_SIZE);
+    std::generate(data.begin(), data.end(), std::ref(rng));
+    field_clamp<FieldT>(data.data(), data.size());
+
+    libsnark::protoboard<FieldT> pb;
+    std::vector<DigVar> out;
+    std::vector<BlockVar> in;
+    std::vector<GadHash> gadget;
+
+    for (size_t i = 0; i < HASHES_N; ++i)
+        out.emplace_back(pb, DIGEST_VARS, FMT("out_%llu", i));
+
+    pb.set_input_sizes(HASHES_N * DIGEST_VARS);
+
+    for (size_t i = 0; i < HASHES_N; ++i)
+        in.emplace_back(make_uniform_array<BlockVar>(pb, DIGEST_VARS, FMT("in_%llu", i)));
+
+    for (size_t i = 0; i < HASHES_N; ++i)
+    {
+        gadget.emplace_back(pb, in[i], out[i], FMT("hash_%llu", i));
+        gadget[i].set_max_terms(max_terms);
+        gadget[i].generate_r1cs_constraints();
+    }
+
+    for (auto &&c : pb.get_constraint_system().constraints)
+        terms += c.a.terms.size() + c.b.terms.size() + c.c.terms.size();
+
+    log_file << max_terms << '\t' << pb.num_constraints() << '\t' << pb.num_variables() << '\t'
+             << terms << '\t';
+    log_file.flush();
+
+    // Witness generation
+    elap = measure(
+        [&]()
+        {
+            for (size_t i = 0; i < HASHES_N; ++i)
+            {
+                for (size_t j = 0; j < Hash::RATE; ++j)
+                    in[i][j].generate_r1cs_witness(data.data() + i * Hash::BLOCK_SIZE +
+                                                       j * Hash::DIGEST_SIZE,
+                                                   Hash::DIGEST_SIZE);
+                gadget[i].generate_r1cs_witness();
+            }
+        },
+        1, 1, "Witness generation", false);
+    log_file << elap << '\t';
+    log_file.flush();
+
+    auto keypair{libsnark::r1cs_ppzksnark_generator<ppT>(pb.get_constraint_system())};
+    libsnark::r1cs_ppzksnark_proof<ppT> proof;
+
+    // Proof generation
+    elap = measure(
+        [&]()
+        {
+            proof = libsnark::r1cs_ppzksnark_prover<ppT>(keypair.pk, pb.primary_input(),
+                                                         pb.auxiliary_input());
+        },
+        1, 1, "Proof generation", false);
+    log_file << elap << '\t';
+
+    log_file << pb.is_satisfied() << '\n';
+    log_file.flush();
+}
+
+template<typename GadHash>
+void bench(const char *name)
+{
+    static constexpr size_t RATIO = GadHash::BLOCK_SIZE / GadHash::DIGEST_SIZE;
+
+    log_file << name << " (" << RATIO << ":1), r = " << GadHash::Hash::ROUNDS_N
+             << ", c = " << GadHash::constraints() << ", nz = " << GadHash::nonzero_terms()
+             << '\n';
+    log_file << table_header;
+    for (size_t max_terms : MAX_TERMS)
+        bench_terms<GadHash>(max_terms);
+    log_file << '\n';
+}
+
+int main()
+{
+    fs::create_directories("./log");
+    std::string timestamp = std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                               std::chrono::system_clock::now().time_since_epoch())
+                                               .count());
+    std::string log_file_name = std::string("./log/benchmark_terms_") + timestamp +
+                                std::string(".log");
+    log_file.open(log_file_name);
+
+    std::cout << "Logging to " << log_file_name << "...\n";
+
+    log_file << std::boolalpha;
+    libff::inhibit_profiling_info = true;
+    libff::inhibit_profiling_counters = true;
+
+    libff::default_ec_pp::init_public_params();
+
+    log_file << "Bounded Linear Combinations Benchmark"
+             << "\n";
+    log_file << "Prime:\t" << FieldT::mod << "\n";
+    log_file << "Permutations per proof:\t" << HASHES_N << "\n";
+
+#ifdef MULTICORE
+    omp_set_num_threads(NUM_THREADS);
+    log_file << "Threads:\t" << omp_get_max_threads() << "\n\n";
+#else
+    log_file << "Threads:\t1\n\n";
+#endif
+
+    /**
+    Each gadget is benchmarked with the maximum sizes of linear combinations in MAX_TERMS: larger
+    linear combinations are replaced by a fresh variable and one more constraint. Fewer nonzero
+    terms make the constraint matrices cheaper to evaluate, more constraints and variables make
+    the FFTs and the multi-exponentiations larger.
+    **/
+
+    bench<ArionGadget<Arion<FieldT, 2, 1, 6>>>("Arion");
+    bench<ArionGadget<Arion<FieldT, 4, 1, 5>>>("Arion");
+    bench<ArionGadget<Arion<FieldT, 8, 1, 4>>>("Arion");
+
+    bench<GriffinGadget<Griffin<FieldT, 2, 1, 12>>>("Griffin");
+    bench<GriffinGadget<Griffin<FieldT, 4, 4, 9>>>("Griffin");
+    bench<GriffinGadget<Griffin<FieldT, 8, 4, 9>>>("Griffin");
+
+    bench<PoseidonGadget<Poseidon<FieldT, 2, 1, 4, 55>>>("Poseidon");
+    bench<PoseidonGadget<Poseidon<FieldT, 4, 1, 4, 56>>>("Poseidon");
+    bench<PoseidonGadget<Poseidon<FieldT, 8, 1, 4, 56>>>("Poseidon");
+
+    log_file.close();
+
+    return 0;
+}
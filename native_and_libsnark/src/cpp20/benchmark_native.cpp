@@ -5,13 +5,18 @@
 #include "hash/poseidon2/poseidon2.hpp"
 #include "hash/rescue/rescue.hpp"
 #include "hash/sha/sha256.hpp"
+#include "tree/fixed_mtree.hpp"
 #include "tree/mtree.hpp"
+#include "util/bench_output.hpp"
 #include "util/measure.hpp"
+#include "util/perf_counters.hpp"
 
 #include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <omp.h>
+#include <pthread.h>
+#include <sched.h>
 #include <string>
 
 
@@ -19,24 +24,116 @@ static constexpr size_t MIN_HEIGHT = 6;
 static constexpr size_t MAX_HEIGHT = 18 + 1; // the +1 is to highlight that the bound is exclusive
 static constexpr size_t STEP_HEIGHT = 6;
 static constexpr int NUM_THREADS = 1;
+// Trees built per height before timing, and timed ones: the log has their median and
+// ./log/*.csv|json all statistics (samples further than 3.5 MADs from the median are dropped)
+static constexpr size_t WARMUP_N = 1;
+static constexpr size_t SAMPLES_N = 5;
+// Count instructions, cycles, cache and branch misses of one more build per height, and log them
+// per node (skipped if perf_event_open is not available)
+static constexpr bool COUNTERS = true;
+// Also build every tree on 2 MB huge pages, and log the time and speedup over regular pages
+static constexpr bool HUGE_PAGES = true;
+// Build one tree per hash on 1, 2, 4, ... threads (and all CPUs), each pinned to its own CPU, and
+// log speedup and parallel efficiency against a single thread. The height is that of a binary
+// tree divided by log2 of the arity (rounded down), so the trees do not have as many leaves:
+// 2^15 for 2:1, 4^7 = 2^14 for 4:1 and 8^4 = 2^12 for 8:1. FixedMTree is binary only, and MTree
+// is parallel only if MULTICORE is set
+static constexpr bool SCALING = true;
+static constexpr size_t SCALING_HEIGHT = 16;
+static constexpr size_t SCALING_SAMPLES_N = 3;
 
 namespace fs = std::filesystem;
 
 using FieldT = libff::Fr<libff::default_ec_pp>;
 
 static std::ofstream log_file;
-static std::string table_header = std::string("Height\t") + std::string("Time");
+static std::unique_ptr<BenchOutput> bench_output;
+static int threads = 1;
+static std::unique_ptr<PerfCounters> counters;
+static std::string table_header = std::string("Height\t") + std::string("Time") +
+                                  std::string(HUGE_PAGES ? "\t2 MB pages\tSpeedup" : "");
+static const std::string counters_header = std::string("\tInstr/node\tCycles/node\tIPC\t") +
+                                           std::string("L1D miss/node\tLLC miss/node\t") +
+                                           std::string("Branch miss/node");
+
+// CPUs the process is allowed to run on
+static const std::vector<int> allowed_cpus{[]
+                                           {
+                                               std::vector<int> v;
+                                               cpu_set_t set;
+
+                                               if (sched_getaffinity(0, sizeof(set), &set) == 0)
+                                                   for (int i = 0; i < CPU_SETSIZE; ++i)
+                                                       if (CPU_ISSET(i, &set))
+                                                           v.push_back(i);
+
+                                               for (int i = v.size(); i < omp_get_num_procs(); ++i)
+                                                   v.push_back(i);
+
+                                               return v;
+                                           }()};
+
+// Run the next parallel regions on n threads, the i-th pinned to the i-th allowed CPU (libgomp
+// keeps the same threads across regions of the same size); n = 0 unpins them
+void pin_threads(int n)
+{
+    omp_set_num_threads(n ? n : allowed_cpus.size());
+
+#pragma omp parallel
+    {
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        if (n)
+            CPU_SET(allowed_cpus[omp_get_thread_num() % allowed_cpus.size()], &set);
+        else
+            for (int cpu : allowed_cpus)
+                CPU_SET(cpu, &set);
+
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+}
+
+// Per node counters as table columns
+void log_counters(const PerfCounts &c)
+{
+    for (size_t i : {PERF_INSTRUCTIONS, PERF_CYCLES})
+        log_file << '\t' << c[i];
+    log_file << '\t' << c.ipc();
+    for (size_t i : {PERF_L1D_MISSES, PERF_LLC_MISSES, PERF_BRANCH_MISSES})
+        log_file << '\t' << c[i];
+}
+
+// Statistics of rebuilding a Tree of data (only the first warmup build allocates), in
+// milliseconds, and the counters per node of one more build if count is given
+template<typename Tree>
+BenchStats bench_rebuild(const std::vector<uint8_t> &data, PerfCounts *count = nullptr)
+{
+    Tree tree;
+    std::vector<double> elap;
+
+    Measurement m{measure_samples([&]() { tree.rebuild(data.data(), data.size()); },
+                                  MeasureConfig{WARMUP_N, SAMPLES_N, 0})};
+
+    for (auto &&x : m.ns)
+        elap.push_back(x / 1'000'000);
+
+    if (counters && count)
+        *count = counters->count([&]() { tree.rebuild(data.data(), data.size()); })
+                     .per_node(Tree::NODES_N);
+
+    return BenchStats::of(elap);
+}
 
 template<size_t height, typename Hash>
-void bench_mtree(size_t trans_idx = 0)
+void bench_mtree(const char *name, size_t trans_idx = 0)
 {
     static constexpr size_t HEIGHT = height;
 
     using Tree = MTree<HEIGHT, Hash>;
+    using HugeTree = MTree<HEIGHT, Hash, MTreePages::HUGE_2MB>;
 
     std::mt19937 rng{std::random_device{}()};
-    double elap = 0;
-    std::unique_ptr<Tree> tree;
     std::vector<uint8_t> data(Tree::INPUT_SIZE);
     //std::generate(data.begin(), data.end(), std::ref(rng));
 
@@ -44,11 +141,105 @@ void bench_mtree(size_t trans_idx = 0)
     log_file.flush();
 
     // Build tree
-    elap = measure([&]() { tree = std::make_unique<Tree>(data.begin(), data.end()); }, 1, 1,
-                   "Tree Generation", false);
+    PerfCounts count;
+    BenchStats stats{bench_rebuild<Tree>(data, &count)};
 
-    log_file << elap << '\n';
+    log_file << stats.median;
     log_file.flush();
+    bench_output->record<Hash>(name, HEIGHT, threads, "Tree", stats, count);
+
+    if (HUGE_PAGES)
+    {
+        BenchStats huge{bench_rebuild<HugeTree>(data)};
+
+        log_file << '\t' << huge.median << '\t' << stats.median / huge.median;
+        bench_output->record<Hash>(name, HEIGHT, threads, "Tree (2 MB pages)", huge);
+    }
+
+    if (counters)
+        log_counters(count);
+    log_file << '\n';
+    log_file.flush();
+}
+
+// Statistics of rebuilding a Tree of data on the current threads, in milliseconds. The tree is
+// allocated and first touched before timing, so only hashing is measured
+template<typename Tree>
+BenchStats bench_scaling_rebuild(const std::vector<uint8_t> &data)
+{
+    Tree tree{data.begin(), data.end()};
+    std::vector<double> elap;
+
+    Measurement m{measure_samples([&]() { tree.rebuild(data.data(), data.size()); },
+                                  MeasureConfig{WARMUP_N, SCALING_SAMPLES_N, 0})};
+
+    for (auto &&x : m.ns)
+        elap.push_back(x / 1'000'000);
+
+    return BenchStats::of(elap);
+}
+
+template<size_t height, typename Hash>
+void bench_scaling(const char *name)
+{
+    static constexpr size_t HEIGHT = height;
+    static constexpr size_t ARITY = Hash::BLOCK_SIZE / Hash::DIGEST_SIZE;
+#ifdef MULTICORE
+    static constexpr bool PARALLEL = true;
+#else
+    static constexpr bool PARALLEL = false;
+#endif
+    static constexpr bool FIXED = ARITY == 2;
+
+    using Tree = MTree<HEIGHT, Hash>;
+    using FixedTree = FixedMTree<HEIGHT, Hash>;
+
+    if (!PARALLEL && !FIXED)
+        return;
+
+    std::vector<uint8_t> data(Tree::INPUT_SIZE);
+    std::vector<int> sweep;
+    double base[2]{};
+
+    for (int t = 1; t < (int)allowed_cpus.size(); t *= 2)
+        sweep.push_back(t);
+    sweep.push_back(allowed_cpus.size());
+
+    log_file << "Scaling, height " << HEIGHT << '\n' << "Threads";
+    if (PARALLEL)
+        log_file << "\tMTree\tSpeedup\tEfficiency";
+    if (FIXED)
+        log_file << "\tFixedMTree\tSpeedup\tEfficiency";
+    log_file << '\n';
+
+    // Time of the tree, then speedup and efficiency against the first (single thread) one
+    auto log_scaling = [&](const char *phase, const BenchStats &stats, double &t1, int t)
+    {
+        if (t == 1)
+            t1 = stats.median;
+
+        log_file << '\t' << stats.median << '\t' << t1 / stats.median << '\t'
+                 << t1 / stats.median / t;
+        bench_output->record<Hash>(name, HEIGHT, t, phase, stats);
+    };
+
+    for (int t : sweep)
+    {
+        pin_threads(t);
+
+        log_file << t;
+        if constexpr (PARALLEL)
+            log_scaling("Tree scaling", bench_scaling_rebuild<Tree>(data), base[0], t);
+        if constexpr (FIXED)
+            log_scaling("FixedTree scaling", bench_scaling_rebuild<FixedTree>(data), base[1], t);
+        log_file << '\n';
+        log_file.flush();
+    }
+
+    log_file << '\n';
+
+    pin_threads(0);
+    omp_set_num_threads(threads);
 }
 
 template<size_t first, size_t last, typename Hash>
@@ -58,7 +249,7 @@ void bench_range(const char *name)
 
     if constexpr (first < last)
     {
-        bench_mtree<first / std::countr_zero(ARITY), Hash>();
+        bench_mtree<first / std::countr_zero(ARITY), Hash>(name);
 
         bench_range<first + STEP_HEIGHT, last, Hash>(name);
     }
@@ -71,9 +262,12 @@ void bench(const char *name)
     static const char *KIND_NAME = "";
 
     log_file << name << ' ' << KIND_NAME << " (" << RATIO << ":1), r = " << Hash::ROUNDS_N << '\n';
-    log_file << table_header << '\n';
+    log_file << table_header << (counters ? counters_header : "") << '\n';
     bench_range<MIN_HEIGHT, MAX_HEIGHT, Hash>(name);
     log_file << '\n';
+
+    if (SCALING)
+        bench_scaling<SCALING_HEIGHT / std::countr_zero(RATIO), Hash>(name);
 }
 
 int main()
@@ -85,6 +279,8 @@ int main()
     std::string log_file_name = std::string("./log/benchmark_native_") + timestamp +
                                 std::string(".log");
     log_file.open(log_file_name);
+    bench_output = std::make_unique<BenchOutput>(std::string("./log/benchmark_native_") +
+                                                 timestamp);
 
     std::cout << "Logging to " << log_file_name << "...\n";
 
@@ -100,11 +296,21 @@ int main()
 
 #ifdef MULTICORE
     omp_set_num_threads(NUM_THREADS);
+    threads = omp_get_max_threads();
     log_file << "Threads:\t" << omp_get_max_threads() << "\n";
 #else
     log_file << "Threads:\t1\n";
 #endif
 
+    if (COUNTERS)
+    {
+        counters = std::make_unique<PerfCounters>();
+        log_file << "Counters:\t" << counters->summary() << "\n";
+
+        if (!counters->available())
+            counters.reset();
+    }
+
     bench<Sha256>("SHA-256 (2:1)");
 
     bench<Arion<FieldT, 2, 1, 6>>("Arion");
@@ -132,6 +338,8 @@ int main()
     bench<Rescue<FieldT, 8, 1, 8>>("Rescue");
 
     log_file.close();
+    bench_output.reset();
+    counters.reset();
 
     return 0;
 }
@@ -0,0 +1,157 @@
+#include "hash/anemoi/anemoi.hpp"
+#include "hash/arion/arion.hpp"
+#include "hash/griffin/griffin.hpp"
+#include "hash/poseidon/poseidon.hpp"
+#include "hash/poseidon2/poseidon2.hpp"
+#include "hash/rescue/rescue.hpp"
+#include "hash/sha/sha256.hpp"
+#include "util/bench_output.hpp"
+#include "util/measure.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+
+// Untimed calls, timed samples and minimum duration of a sample
+static const MeasureConfig CONFIG{100, 21, 20};
+
+namespace fs = std::filesystem;
+
+using FieldT = libff::Fr<libff::default_ec_pp>;
+
+static std::ofstream log_file;
+static std::unique_ptr<BenchOutput> bench_output;
+static std::string table_header = std::string("Interface\t") + std::string("ns/call\t") +
+                                  std::string("MAD\t") + std::string("Cycles/call\t") +
+                                  std::string("MB/s");
+
+// Times are logged per block, out of calls which process `blocks` blocks each
+template<typename Hash>
+void log_measurement(const char *name, const char *interface, const Measurement &m,
+                     size_t blocks = 1)
+{
+    std::vector<double> ms;
+
+    for (auto &&x : m.ns)
+        ms.push_back(x / blocks / 1'000'000);
+
+    log_file << interface << '\t' << m.median_ns / blocks << '\t' << m.mad_ns / blocks << '\t'
+             << m.median_cycles / blocks << '\t' << Hash::BLOCK_SIZE * 1000. * blocks / m.median_ns
+             << '\n';
+    log_file.flush();
+    bench_output->record<Hash>(name, 0, 1, interface, BenchStats::of(ms));
+}
+
+template<typename Hash>
+void bench(const char *name)
+{
+    static constexpr size_t RATIO = Hash::BLOCK_SIZE / Hash::DIGEST_SIZE;
+
+    std::mt19937 rng{std::random_device{}()};
+    std::vector<uint8_t> block(Hash::BLOCK_SIZE);
+    std::vector<uint8_t> digest(Hash::DIGEST_SIZE);
+
+    std::generate(block.begin(), block.end(), std::ref(rng));
+
+    log_file << name << " (" << RATIO << ":1), r = " << Hash::ROUNDS_N << '\n';
+    log_file << table_header << '\n';
+
+    // Permutation alone, on a state of field elements which is restored before every call
+    if constexpr (requires { typename Hash::Field; })
+    {
+        using State = std::array<typename Hash::Field, Hash::BRANCH_N>;
+
+        field_clamp<typename Hash::Field>(block.data(), block.size());
+
+        State init{};
+        State state;
+
+        field_load(init.data(), block.data(), Hash::BLOCK_SIZE / Hash::DIGEST_SIZE);
+
+        Measurement m{measure_samples([&]() { Hash::hash_field(state); }, CONFIG,
+                                      [&]() { state = init; })};
+
+        consume(state);
+        log_measurement<Hash>(name, "hash_field", m);
+
+        // Independent states permuted in lockstep, where the hash has such a kernel
+        if constexpr (requires { Hash::LANES; })
+        {
+            std::array<State, Hash::LANES> states;
+
+            Measurement ml{measure_samples([&]() { Hash::hash_field_lanes(states); }, CONFIG,
+                                           [&]() { states.fill(init); })};
+
+            consume(states);
+            log_measurement<Hash>(name, "hash_field_lanes", ml, Hash::LANES);
+        }
+    }
+
+    // Byte interface: (de)serialization included
+    Measurement m{
+        measure_samples([&]() { Hash::hash_oneblock(digest.data(), block.data()); }, CONFIG)};
+
+    consume(digest);
+    log_measurement<Hash>(name, "hash_oneblock", m);
+
+    log_file << '\n';
+}
+
+int main()
+{
+    fs::create_directories("./log");
+    std::string timestamp = std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                               std::chrono::system_clock::now().time_since_epoch())
+                                               .count());
+    std::string log_file_name = std::string("./log/benchmark_perm_") + timestamp +
+                                std::string(".log");
+    log_file.open(log_file_name);
+    bench_output = std::make_unique<BenchOutput>(std::string("./log/benchmark_perm_") +
+                                                 timestamp);
+
+    std::cout << "Logging to " << log_file_name << "...\n";
+
+    libff::inhibit_profiling_info = true;
+    libff::inhibit_profiling_counters = true;
+
+    libff::default_ec_pp::init_public_params();
+
+    log_file << "Permutation Benchmark"
+             << "\n";
+    log_file << "Prime:\t" << FieldT::mod << "\n";
+    log_file << "TSC:\t" << tsc_ghz() << " GHz\n\n";
+
+    bench<Sha256>("SHA-256");
+
+    bench<Arion<FieldT, 2, 1, 6>>("Arion");
+    bench<Arion<FieldT, 4, 1, 5>>("Arion");
+    bench<Arion<FieldT, 8, 1, 4>>("Arion");
+
+    bench<Anemoi<FieldT, 2, 2, 14>>("Anemoi");
+    bench<Anemoi<FieldT, 4, 2, 12>>("Anemoi");
+    bench<Anemoi<FieldT, 8, 2, 11>>("Anemoi");
+
+    bench<Griffin<FieldT, 2, 1, 12>>("Griffin");
+    bench<Griffin<FieldT, 4, 4, 9>>("Griffin");
+    bench<Griffin<FieldT, 8, 4, 9>>("Griffin");
+
+    bench<Poseidon<FieldT, 2, 1, 4, 55>>("Poseidon");
+    bench<Poseidon<FieldT, 4, 1, 4, 56>>("Poseidon");
+    bench<Poseidon<FieldT, 8, 1, 4, 56>>("Poseidon");
+
+    bench<Poseidon2<FieldT, 2, 4, 55>>("Poseidon2");
+    bench<Poseidon2<FieldT, 4, 4, 56>>("Poseidon2");
+    bench<Poseidon2<FieldT, 8, 4, 56>>("Poseidon2");
+
+    bench<Rescue<FieldT, 2, 1, 14>>("Rescue");
+    bench<Rescue<FieldT, 4, 1, 9>>("Rescue");
+    bench<Rescue<FieldT, 8, 1, 8>>("Rescue");
+
+    log_file.close();
+    bench_output.reset();
+
+    return 0;
+}
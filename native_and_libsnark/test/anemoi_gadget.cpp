@@ -3,6 +3,7 @@
 #include "util/array_utils.hpp"
 #include "util/measure.hpp"
 #include "util/string_utils.hpp"
+#include "gadget_size.hpp"
 
 #include <libsnark/common/default_types/r1cs_ppzksnark_pp.hpp>
 #include <libsnark/zk_proof_systems/ppzksnark/r1cs_ppzksnark/r1cs_ppzksnark.hpp>
@@ -13,12 +14,12 @@
 using ppT = libsnark::default_r1cs_ppzksnark_pp;
 using FieldT = libff::Fr<ppT>;
 
+template<typename GadHash = AnemoiGadget<Anemoi<FieldT, 7, 3>>>
 bool test()
 {
-    using GadHash = AnemoiGadget<Anemoi<FieldT, 7, 3>>;
-    using Hash = GadHash::Hash;
-    using DigVar = GadHash::DigVar;
-    using BlockVar = GadHash::BlockVar;
+    using Hash = typename GadHash::Hash;
+    using DigVar = typename GadHash::DigVar;
+    using BlockVar = typename GadHash::BlockVar;
 
     static constexpr size_t DIGEST_VARS = GadHash::DIGEST_VARS;
 
@@ -89,6 +90,18 @@ static bool run_tests()
     std::cout << check << '\n';
     all_check &= check;
 
+    std::cout << "Hashing (2:2)... ";
+    std::cout.flush();
+    check = test<AnemoiGadget<Anemoi<FieldT, 2, 2>>>();
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Size... ";
+    std::cout.flush();
+    check = test_size<AnemoiGadget<Anemoi<FieldT, 7, 3>>>();
+    std::cout << check << '\n';
+    all_check &= check;
+
     return all_check;
 }
 
@@ -2,6 +2,7 @@
 #include "hash/arion/arion.hpp"
 #include "util/array_utils.hpp"
 #include "util/measure.hpp"
+#include "gadget_size.hpp"
 
 #include <libsnark/common/default_types/r1cs_ppzksnark_pp.hpp>
 #include <libsnark/zk_proof_systems/ppzksnark/r1cs_ppzksnark/r1cs_ppzksnark.hpp>
@@ -90,6 +91,12 @@ static bool run_tests()
     std::cout << check << '\n';
     all_check &= check;
 
+    std::cout << "Size... ";
+    std::cout.flush();
+    check = test_size<ArionGadget<Arion<FieldT, 7, 3>>>();
+    std::cout << check << '\n';
+    all_check &= check;
+
     return all_check;
 }
 
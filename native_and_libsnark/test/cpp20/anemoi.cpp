@@ -9,7 +9,8 @@ using Hash = Anemoi<FieldT, 2, 2>;
 
 static bool run_tests()
 {
-    //There are no test vectors for MiMC, so we assume our implementation to be correct
+    // There are no published test vectors for this parameter set: this is the digest of the
+    // all-zero block by this implementation, it guards against unintended changes
     uint8_t msg[Hash::BLOCK_SIZE]{};
     uint8_t dig[Hash::DIGEST_SIZE]{};
     auto real_dig = HEXARRAY(49e478c4b15076f5545ce867afef9d99a91782f40886709b31261b8828a77dfc);
@@ -29,6 +30,29 @@ static bool run_tests()
     std::cout << check << '\n';
     all_check &= check;
 
+    std::cout << "Lanes... ";
+    check = true;
+    {
+        // 10 branches (l = 5), as in the 8:1 tree
+        using WideHash = Anemoi<FieldT, 8, 2, 11>;
+
+        std::array<WideHash::Sponge, WideHash::LANES> h;
+
+        for (auto &&x : h)
+            for (auto &&y : x)
+                y = FieldT::random_element();
+
+        auto ref{h};
+
+        for (auto &&x : ref)
+            WideHash::hash_field(x);
+        WideHash::hash_field_lanes(h);
+
+        check = h == ref;
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
     return all_check;
 
     return true;
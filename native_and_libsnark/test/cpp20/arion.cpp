@@ -34,6 +34,26 @@ static bool run_tests()
     std::cout << check << '\n';
     all_check &= check;
 
+    std::cout << "Lanes... ";
+    check = true;
+    {
+        std::array<Hash::Sponge, Hash::LANES> h;
+
+        for (auto &&x : h)
+            for (auto &&y : x)
+                y = FieldT::random_element();
+
+        auto ref{h};
+
+        for (auto &&x : ref)
+            Hash::hash_field(x);
+        Hash::hash_field_lanes(h);
+
+        check = h == ref;
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
     return all_check;
 
     return true;
@@ -29,6 +29,29 @@ static bool run_tests()
     std::cout << check << '\n';
     all_check &= check;
 
+    std::cout << "Lanes... ";
+    check = true;
+    {
+        // Wide state (t = 12), as in the 8:1 tree
+        using WideHash = Griffin<FieldT, 8, 4, 9>;
+
+        std::array<WideHash::Sponge, WideHash::LANES> h;
+
+        for (auto &&x : h)
+            for (auto &&y : x)
+                y = FieldT::random_element();
+
+        auto ref{h};
+
+        for (auto &&x : ref)
+            WideHash::hash_field(x);
+        WideHash::hash_field_lanes(h);
+
+        check = h == ref;
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
     return all_check;
 
     return true;
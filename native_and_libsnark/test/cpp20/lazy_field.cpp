@@ -0,0 +1,272 @@
+#include "hash/anemoi/anemoi.hpp"
+#include "hash/arion/arion.hpp"
+#include "hash/griffin/griffin.hpp"
+#include "hash/poseidon2/poseidon2.hpp"
+#include "hash/rescue/rescue.hpp"
+#include "util/lazy_field.hpp"
+#include <iostream>
+#include <vector>
+
+using FieldT = libff::Fr<libff::default_ec_pp>;
+
+static constexpr size_t SAMPLES_N = 64;
+
+template<size_t n>
+using Vector = std::array<FieldT, n>;
+
+template<size_t n>
+static Vector<n> random_vector()
+{
+    Vector<n> x;
+
+    for (auto &&y : x)
+        y = FieldT::random_element();
+
+    return x;
+}
+
+// Reference product, fully reduced after every operation
+template<size_t n, typename Entry>
+static Vector<n> reference_matmul(const Vector<n> &x, Entry m)
+{
+    Vector<n> y{};
+
+    for (size_t i = 0; i < n; ++i)
+        for (size_t j = 0; j < n; ++j)
+            y[i] += FieldT(m(i, j)) * x[j];
+
+    return y;
+}
+
+// Compares a linear layer with its matrix on random inputs and on the all p - 1 input
+template<size_t n, typename Layer, typename Entry>
+static bool check_layer(Layer layer, Entry m)
+{
+    bool check = true;
+
+    for (size_t k = 0; k <= SAMPLES_N; ++k)
+    {
+        Vector<n> x{random_vector<n>()};
+
+        if (k == SAMPLES_N)
+            x.fill(FieldT(-1));
+
+        Vector<n> y{x};
+
+        layer(y);
+        check &= y == reference_matmul<n>(x, m);
+    }
+
+    return check;
+}
+
+template<size_t t>
+static bool check_rescue()
+{
+    using Hash = Rescue<FieldT, t - 1, 1>;
+
+    return check_layer<t>(Hash::matmul, [](size_t i, size_t j) { return Hash::MAT[i * t + j]; });
+}
+
+template<size_t t>
+static bool check_arion()
+{
+    using Hash = Arion<FieldT, t - 1, 1>;
+
+    return check_layer<t>(Hash::circular,
+                          [](size_t i, size_t j) { return Hash::CIRC_MAT[(t + j - i) % t]; });
+}
+
+template<size_t t>
+static bool check_griffin()
+{
+    using Hash = Griffin<FieldT, t - 1, 1>;
+
+    if constexpr (t <= 4)
+        return check_layer<t>(Hash::circular,
+                              [](size_t i, size_t j) { return Hash::CIRC_MAT[(t + j - i) % t]; });
+    else
+        return check_layer<t>(Hash::circular,
+                              [](size_t i, size_t j)
+                              { return Hash::CIRC_MAT[4 * (i / 4 != j / 4) + j % 4]; });
+}
+
+template<size_t l>
+static bool check_anemoi()
+{
+    using Hash = Anemoi<FieldT, l, l>;
+
+    // Matrices applied by matmul for l <= 4, from g = 7
+    static constexpr uint64_t g = Hash::G;
+    static constexpr uint64_t M2[2][2]{{1, g}, {g, g * g + 1}};
+    static constexpr uint64_t M3[3][3]{{g + 1, 1, g + 1}, {1, 1, g}, {g, 1, 1}};
+    static constexpr uint64_t M4[4][4]{{1, g + 1, g, g},
+                                       {g * g, g * g + g, g + 1, g + g + 1},
+                                       {g * g, g * g, 1, g + 1},
+                                       {g + 1, g + g + 1, g, g + 1}};
+
+    return check_layer<l>(Hash::matmul,
+                          [](size_t i, size_t j) -> uint64_t
+                          {
+                              if constexpr (l == 2)
+                                  return M2[i][j];
+                              else if constexpr (l == 3)
+                                  return M3[i][j];
+                              else if constexpr (l == 4)
+                                  return M4[i][j];
+                              else
+                                  return Hash::MAT[i * l + j];
+                          });
+}
+
+template<size_t t>
+static bool check_poseidon2()
+{
+    using Hash = Poseidon2<FieldT, t>;
+
+    // M4 of the external layer for t >= 4, circ(2 M4, M4, ..., M4)
+    static constexpr uint64_t M4[4][4]{{5, 7, 1, 3}, {4, 6, 1, 1}, {1, 3, 5, 7}, {1, 1, 4, 6}};
+    static constexpr uint64_t M3[3][3]{{2, 1, 1}, {1, 3, 1}, {1, 1, 5}};
+    static constexpr uint64_t M2[2][2]{{2, 1}, {1, 3}};
+
+    bool check = check_layer<t>(Hash::ext_matmul,
+                                [](size_t i, size_t j) -> uint64_t
+                                {
+                                    if constexpr (t == 2)
+                                        return M2[i][j];
+                                    else if constexpr (t == 3)
+                                        return M3[i][j];
+                                    else
+                                        return M4[i % 4][j % 4] * (1 + (i / 4 == j / 4));
+                                });
+
+    // Internal layer for t >= 4, diag(1, ..., t) + all-ones
+    if constexpr (t >= 4)
+        check &= check_layer<t>(Hash::int_matmul,
+                                [](size_t i, size_t j) { return Hash::INT_MAT[i] * (i == j) + 1; });
+
+    return check;
+}
+
+static bool run_tests()
+{
+    bool check = true;
+    bool all_check = true;
+
+    std::cout << std::boolalpha;
+
+    std::cout << "Sums and differences... ";
+    check = true;
+    for (size_t k = 0; k < SAMPLES_N; ++k)
+    {
+        std::vector<FieldT> x(k + 1);
+        FieldT sum{x[0] = FieldT::random_element()};
+        LazyField<FieldT> lazy{x[0]};
+
+        for (size_t i = 1; i <= k; ++i)
+        {
+            x[i] = FieldT::random_element();
+
+            if (i % 3 == 2)
+            {
+                sum -= x[i];
+                lazy -= x[i];
+            }
+            else
+            {
+                sum += x[i];
+                lazy += x[i];
+            }
+        }
+
+        check &= lazy.reduce() == sum;
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Doublings... ";
+    check = true;
+    {
+        FieldT x{FieldT::random_element()};
+        LazyField<FieldT> lazy{x};
+
+        // Up to 2^62 times the input, the top limb nearly full
+        for (size_t i = 0; i < 62; ++i)
+        {
+            x += x;
+            lazy += lazy;
+
+            check &= lazy.reduce() == x;
+        }
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Extremes... ";
+    check = true;
+    {
+        FieldT max{FieldT(-1)};
+        FieldT sum{};
+        LazyField<FieldT> lazy;
+        LazyField<FieldT> zero;
+
+        check &= zero.reduce() == FieldT::zero();
+
+        // Subtracting p - 1 from 0 and adding it back
+        zero -= max;
+        zero += max;
+        check &= zero.reduce() == FieldT::zero();
+
+        for (size_t i = 0; i < 100'000; ++i)
+        {
+            sum += max;
+            lazy += max;
+        }
+        check &= lazy.reduce() == sum;
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Rescue MDS... ";
+    check = check_rescue<3>() && check_rescue<5>() && check_rescue<9>();
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Arion circulant... ";
+    check = check_arion<3>() && check_arion<5>() && check_arion<9>();
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Griffin circulant... ";
+    check = check_griffin<3>() && check_griffin<4>() && check_griffin<8>() && check_griffin<12>();
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Anemoi matrix... ";
+    check = check_anemoi<2>() && check_anemoi<3>() && check_anemoi<4>() && check_anemoi<6>();
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Poseidon2 matrices... ";
+    check = check_poseidon2<2>() && check_poseidon2<3>() && check_poseidon2<4>() &&
+            check_poseidon2<8>() && check_poseidon2<16>();
+    std::cout << check << '\n';
+    all_check &= check;
+
+    return all_check;
+}
+
+int main()
+{
+    std::cout << "\n==== Testing LazyField ====\n";
+
+    bool all_check = run_tests();
+
+    std::cout << "\n==== " << (all_check ? "ALL TESTS SUCCEEDED" : "SOME TESTS FAILED")
+              << " ====\n\n";
+
+#ifdef MEASURE_PERFORMANCE
+#endif
+
+    return 0;
+}
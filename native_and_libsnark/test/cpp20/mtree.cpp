@@ -57,6 +57,30 @@ static bool run_tests()
     std::cout << check << '\n';
     all_check &= check;
 
+    std::cout << "Rebuild Arion... ";
+    check = true;
+    {
+        using Hash = Arion<FieldT, 2, 1>;
+        using Tree = MTree<HEIGHT, Hash>;
+
+        std::vector<uint8_t> data(Tree::INPUT_SIZE);
+        Tree tree;
+
+        for (size_t i = 0; i < 2; ++i)
+        {
+            for (size_t j = 0; j < data.size(); ++j)
+                data[j] = i + j;
+
+            Tree fresh(data.begin(), data.end());
+
+            check &= tree.rebuild(data.data(), data.size());
+            check &= memcmp(tree.digest(), fresh.digest(), Hash::DIGEST_SIZE) == 0;
+            check &= tree.get_node(0)->parent() == tree.get_node(Tree::LEAVES_N);
+        }
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
     std::cout << "Tree Path SHA256... ";
     check = true;
     {
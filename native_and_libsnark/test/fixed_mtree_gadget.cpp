@@ -1,13 +1,14 @@
 #include "gadget/fixed_mtree_gadget.hpp"
+#include "gadget/mtree_gadget.hpp"
+#include "gadget/hash/arion/arion_gadget.hpp"
 #include "gadget/hash/griffin/griffin_gadget.hpp"
-#include "gadget/hash/mimc/mimc256_gadget.hpp"
-#include "gadget/hash/mimc/mimc512f_gadget.hpp"
-#include "gadget/hash/mimc/mimc512f2k_gadget.hpp"
 #include "gadget/hash/poseidon/poseidon_gadget.hpp"
-#include "gadget/hash/sha256/sha256_gadget_pp.hpp"
-#include "gadget/hash/sha512/sha512_gadget.hpp"
-#include "gadget/hash/arion/arion_gadget.hpp"
-#include "tree/fixed_mtree.hpp"
+
+#include "hash/arion/arion.hpp"
+#include "hash/griffin/griffin.hpp"
+#include "hash/poseidon/poseidon.hpp"
+
+#include "tree/mtree.hpp"
 #include "util/measure.hpp"
 
 #include <libsnark/common/default_types/r1cs_ppzksnark_pp.hpp>
@@ -18,324 +19,108 @@
 #include <fstream>
 #include <omp.h>
 
-static constexpr size_t TRANS_IDX = 0;
-static constexpr size_t TREE_HEIGHT = 4;
+static constexpr size_t TREE_HEIGHT = 3;
 
 using ppT = libsnark::default_r1cs_ppzksnark_pp;
 using FieldT = libff::Fr<ppT>;
 
-using GadSha256 = sha256_two_to_one_hash_gadget<FieldT>;
-using GadSha512 = libsnark::sha512::sha512_two_to_one_hash_gadget<FieldT>;
-
-using GadGriffin = griffin_two_to_one_hash_gadget<FieldT>;
-using GadMimc256 = mimc256_two_to_one_hash_gadget<FieldT>;
-using GadMimc512F = mimc512f_two_to_one_hash_gadget<FieldT>;
-using GadMimc512F2K = mimc512f2k_two_to_one_hash_gadget<FieldT>;
-using GadPoseidon = poseidon_two_to_one_hash_gadget<FieldT>;
-using GadArion = arion_two_to_one_hash_gadget<FieldT>;
-
-template<size_t tree_height, typename GadHash>
-bool test_mtree()
+template<typename GadTree>
+struct TreeCircuit
 {
-    using Hash = typename GadHash::Hash;
-    using Mtree = FixedMTree<tree_height, Hash>;
-    using DigVar = libsnark::digest_variable<FieldT>;
+    /* TreeCircuit
+    * A tree gadget on its own protoboard, with the leaf and the siblings as inputs.
+    */
+    using DigVar = typename GadTree::DigVar;
+    using Level = typename GadTree::Level;
 
-    static constexpr size_t DIGEST_VARS = GadHash::DIGEST_VARS;
-
-    static std::mt19937 rng{std::random_device{}()};
+    static constexpr size_t DIGEST_VARS = GadTree::DIGEST_VARS;
 
-    // Build tree
-    std::vector<uint8_t> data(Mtree::INPUT_SIZE);
-    std::generate(data.begin(), data.end(), std::ref(rng));
-    Mtree tree{data.begin(), data.end()};
-
-    std::cout << '\n' << tree << '\n';
-
-    // Extract our transaction
-    libff::bit_vector trans_bv(DIGEST_VARS);
-    unpack_bits(trans_bv, tree.get_node(TRANS_IDX)->get_digest());
-
-    // Extract other transaction/middle nodes
-    std::vector<libff::bit_vector> other_bv(tree_height - 1, libff::bit_vector(DIGEST_VARS));
-    for (size_t i = 0, j = 1; i < other_bv.size(); ++i, j += 1ULL << (tree_height - i))
-        unpack_bits(other_bv[i], tree.get_node(j)->get_digest());
-
-    // Extract output node
-    libff::bit_vector out_bv(DIGEST_VARS);
-    unpack_bits(out_bv, tree.digest());
-
-    // Test Gadget
     libsnark::protoboard<FieldT> pb;
-    DigVar out{pb, DIGEST_VARS, FMT("out")};
-    DigVar trans{pb, DIGEST_VARS, FMT("trans")};
-    std::vector<DigVar> other;
-
-    for (size_t i = 0; i < tree_height - 1; ++i)
-        other.emplace_back(pb, DIGEST_VARS, FMT("other_%llu", i));
-
-    pb.set_input_sizes(DIGEST_VARS);
-    FixedMTreeGadget<GadHash> gadget{pb, out, trans, other, TRANS_IDX, FMT("merkle_tree")};
-
-    out.generate_r1cs_constraints();
-    trans.generate_r1cs_constraints();
-    for (size_t i = 0; i < other.size(); ++i)
-        other[i].generate_r1cs_constraints();
-    gadget.generate_r1cs_constraints();
-
-
-    //    out.generate_r1cs_witness(out_bv);
-    trans.generate_r1cs_witness(trans_bv);
-    for (size_t i = 0; i < other.size(); ++i)
-        other[i].generate_r1cs_witness(other_bv[i]);
-    gadget.generate_r1cs_witness();
-
-    bool result;
+    DigVar out;
+    DigVar trans;
+    std::vector<Level> other;
+    GadTree gadget;
+
+    TreeCircuit(size_t height) :
+        out{pb, DIGEST_VARS, FMT("out")},
+        trans{pb, DIGEST_VARS, FMT("trans")},
+        other{[&]()
+              {
+                  std::vector<Level> v;
+
+                  for (size_t i = 0; i < height - 1; ++i)
+                      v.emplace_back(make_uniform_array<Level>(pb, DIGEST_VARS, FMT("other")));
+
+                  return v;
+              }()},
+        gadget{pb, out, trans, other, FMT("merkle_tree")}
     {
-        uint8_t buff[Hash::DIGEST_SIZE]{};
-        std::vector<bool> buff_bv(DIGEST_VARS);
-
-        for (size_t i = 0; i < DIGEST_VARS; ++i)
-            buff_bv[i] = pb.val(out.bits[i]).as_ulong();
-        pack_bits(buff, buff_bv);
-
-        std::string vanilla_dump{hexdump(tree.digest(), Hash::DIGEST_SIZE)};
-        std::string zkp_dump{hexdump(buff)};
-
-        //std::cout << "\nVanilla output:\t" << vanilla_dump << '\n';
-        //std::cout << "ZKP output:\t" << zkp_dump << '\n';
-
-        result = vanilla_dump == zkp_dump;
+        pb.set_input_sizes(DIGEST_VARS);
+        gadget.generate_r1cs_constraints();
     }
 
-    auto keypair = libsnark::r1cs_ppzksnark_generator<ppT>(pb.get_constraint_system());
-    auto proof = libsnark::r1cs_ppzksnark_prover<ppT>(keypair.pk, pb.primary_input(),
-                                                      pb.auxiliary_input());
-
-    result &= libsnark::r1cs_ppzksnark_verifier_strong_IC<ppT>(keypair.vk, pb.primary_input(),
-                                                               proof);
-
-    return result;
-}
-
-template<size_t tree_height, typename GadHash>
-bool test_mtree_path()
-{
-    using Hash = typename GadHash::Hash;
-    using Mtree = FixedMTreePath<tree_height, Hash>;
-    using DigVar = libsnark::digest_variable<FieldT>;
-
-    static constexpr size_t DIGEST_VARS = GadHash::DIGEST_VARS;
-
-    static std::mt19937 rng{std::random_device{}()};
-
-    // Build tree
-    std::vector<uint8_t> data(Mtree::INPUT_SIZE);
-    std::generate(data.begin(), data.end(), std::ref(rng));
-    Mtree tree{data.begin(), data.end()};
-
-    std::cout << '\n' << tree << '\n';
-
-    // Extract our transaction
-    libff::bit_vector trans_bv(DIGEST_VARS);
-    unpack_bits(trans_bv, data.data());
-
-    // Extract other transaction/middle nodes
-    std::vector<libff::bit_vector> other_bv(tree_height - 1, libff::bit_vector(DIGEST_VARS));
-    for (size_t i = 0; i < other_bv.size(); ++i)
-        unpack_bits(other_bv[i], data.data() + (i + 1) * Hash::DIGEST_SIZE);
-
-    // Extract output node
-    libff::bit_vector out_bv(DIGEST_VARS);
-    unpack_bits(out_bv, tree.digest());
-
-    // Test Gadget
-    libsnark::protoboard<FieldT> pb;
-    DigVar out{pb, DIGEST_VARS, FMT("out")};
-    DigVar trans{pb, DIGEST_VARS, FMT("trans")};
-    std::vector<DigVar> other;
-
-    for (size_t i = 0; i < tree_height - 1; ++i)
-        other.emplace_back(pb, DIGEST_VARS, FMT("other_%llu", i));
-
-    pb.set_input_sizes(DIGEST_VARS);
-    FixedMTreeGadget<GadHash> gadget{pb, out, trans, other, TRANS_IDX, FMT("merkle_tree")};
-
-    out.generate_r1cs_constraints();
-    trans.generate_r1cs_constraints();
-    for (size_t i = 0; i < other.size(); ++i)
-        other[i].generate_r1cs_constraints();
-    gadget.generate_r1cs_constraints();
-
-
-    //    out.generate_r1cs_witness(out_bv);
-    trans.generate_r1cs_witness(trans_bv);
-    for (size_t i = 0; i < other.size(); ++i)
-        other[i].generate_r1cs_witness(other_bv[i]);
-    gadget.generate_r1cs_witness();
-
-    bool result;
+    template<typename Tree>
+    std::string prove(const Tree &tree, size_t trans_idx)
     {
-        uint8_t buff[Hash::DIGEST_SIZE]{};
-        std::vector<bool> buff_bv(DIGEST_VARS);
-
-        for (size_t i = 0; i < DIGEST_VARS; ++i)
-            buff_bv[i] = pb.val(out.bits[i]).as_ulong();
-        pack_bits(buff, buff_bv);
-
-        std::string vanilla_dump{hexdump(tree.digest(), Hash::DIGEST_SIZE)};
-        std::string zkp_dump{hexdump(buff)};
-
-        //        std::cout << "\nVanilla output:\t" << vanilla_dump << '\n';
-        //        std::cout << "ZKP output:\t" << zkp_dump << '\n';
-
-        result = vanilla_dump == zkp_dump;
-    }
-
-    auto keypair = libsnark::r1cs_ppzksnark_generator<ppT>(pb.get_constraint_system());
-    auto proof = libsnark::r1cs_ppzksnark_prover<ppT>(keypair.pk, pb.primary_input(),
-                                                      pb.auxiliary_input());
-
-    result &= libsnark::r1cs_ppzksnark_verifier_strong_IC<ppT>(keypair.vk, pb.primary_input(),
-                                                               proof);
-
-    return result;
-}
-
-template<size_t tree_height, typename GadHash>
-bool test_pmtree()
-{
-    using Hash = typename GadHash::Hash;
-    using Mtree = FixedMTree<tree_height, Hash>;
-    using DigVar = FieldVariable<FieldT>;
-
-    static constexpr size_t DIGEST_VARS = GadHash::DIGEST_VARS;
-
-    static std::mt19937 rng{4};
-
-    // Build tree
-    std::vector<uint8_t> data(Mtree::INPUT_SIZE);
-    std::generate(data.begin(), data.end(), std::ref(rng));
-    Mtree tree{data.begin(), data.end()};
-
-    std::cout << '\n' << tree;
+        trans.generate_r1cs_witness(tree.get_node(trans_idx)->get_digest());
 
-    // There is no need to extract as FieldVariable does that for us
-
-    // Test Gadget
-    libsnark::protoboard<FieldT> pb;
-    DigVar out{pb, DIGEST_VARS, FMT("out")};
-    DigVar trans{pb, DIGEST_VARS, FMT("trans")};
-    std::vector<DigVar> other;
+        const auto *aux = tree.get_node(trans_idx)->parent();
+        for (size_t i = 0; i < other.size(); ++i, aux = aux->parent())
+            for (size_t j = 0; j < other[i].size(); ++j)
+                other[i][j].generate_r1cs_witness(aux->child(j)->get_digest());
 
-    for (size_t i = 0; i < tree_height - 1; ++i)
-        other.emplace_back(pb, DIGEST_VARS, FMT("other_%llu", i));
+        gadget.generate_r1cs_witness(trans_idx);
 
-    pb.set_input_sizes(DIGEST_VARS);
-    FixedMTreeGadget<GadHash> gadget{pb, out, trans, other, TRANS_IDX, FMT("merkle_tree")};
-
-    out.generate_r1cs_constraints();
-    trans.generate_r1cs_constraints();
-    for (size_t i = 0; i < other.size(); ++i)
-        other[i].generate_r1cs_constraints();
-    gadget.generate_r1cs_constraints();
-
-    //    out.generate_r1cs_witness(tree.digest());
-    trans.generate_r1cs_witness(tree.get_node(TRANS_IDX)->get_digest());
-    for (size_t i = 0, j = 1; i < other.size(); ++i, j += 1ULL << (tree_height - i))
-        other[i].generate_r1cs_witness(tree.get_node(j)->get_digest());
-    gadget.generate_r1cs_witness();
-
-
-    bool result;
-    {
-        std::string vanilla{hexdump(tree.digest(), Hash::DIGEST_SIZE)};
-        std::string zkp;
+        std::string dump;
 
         for (auto &&x : out)
-            zkp += hexdump(pb.val(x).as_bigint());
-
-        //        std::cout << "\nVanilla output:\t" << vanilla << '\n';
-        //        std::cout << "ZKP output:\t" << zkp << '\n';
+            dump += hexdump(pb.val(x));
 
-        result = vanilla == zkp;
+        return dump;
     }
+};
 
-    auto keypair = libsnark::r1cs_ppzksnark_generator<ppT>(pb.get_constraint_system());
-    auto proof = libsnark::r1cs_ppzksnark_prover<ppT>(keypair.pk, pb.primary_input(),
-                                                      pb.auxiliary_input());
-
-    result &= libsnark::r1cs_ppzksnark_verifier_strong_IC<ppT>(keypair.vk, pb.primary_input(),
-                                                               proof);
-
-    return result;
-}
-
-template<size_t tree_height, typename GadHash>
-bool test_pmtree_path()
+template<typename GadHash>
+bool test_fixed_mtree()
 {
+    using GadTree = MTreeGadget<TREE_HEIGHT, GadHash>;
+    using GadFixed = FixedMTreeGadget<GadHash>;
     using Hash = typename GadHash::Hash;
-    using Mtree = FixedMTreePath<tree_height, Hash>;
-    using DigVar = FieldVariable<FieldT>;
-
-    static constexpr size_t DIGEST_VARS = GadHash::DIGEST_VARS;
+    using Tree = MTree<TREE_HEIGHT, Hash>;
 
     static std::mt19937 rng{std::random_device{}()};
 
     // Build tree
-    std::vector<uint8_t> data(Mtree::INPUT_SIZE);
+    std::vector<uint8_t> data(Tree::INPUT_SIZE);
     std::generate(data.begin(), data.end(), std::ref(rng));
-    Mtree tree{data.begin(), data.end()};
+    field_clamp<FieldT>(data.data(), data.size());
 
-    std::cout << '\n' << tree << '\n';
+    Tree tree{data.begin(), data.end()};
 
-    // There is no need to extract anything as FieldVariable does that for us
+    TreeCircuit<GadTree> ref{TREE_HEIGHT};
+    TreeCircuit<GadFixed> fixed{TREE_HEIGHT};
 
-    // Test Gadget
-    libsnark::protoboard<FieldT> pb;
-    DigVar out{pb, DIGEST_VARS, FMT("out")};
-    DigVar trans{pb, DIGEST_VARS, FMT("trans")};
-    std::vector<DigVar> other;
-
-    for (size_t i = 0; i < tree_height - 1; ++i)
-        other.emplace_back(pb, DIGEST_VARS, FMT("other_%llu", i));
-
-    pb.set_input_sizes(DIGEST_VARS);
-    FixedMTreeGadget<GadHash> gadget{pb, out, trans, other, 0, FMT("merkle_tree")};
+    // Same circuit as the compile-time tree
+    bool result = fixed.pb.num_constraints() == GadTree::constraints() &&
+                  fixed.pb.num_constraints() == GadFixed::constraints(TREE_HEIGHT);
 
-    out.generate_r1cs_constraints();
-    trans.generate_r1cs_constraints();
-    for (size_t i = 0; i < other.size(); ++i)
-        other[i].generate_r1cs_constraints();
-    gadget.generate_r1cs_constraints();
+    // One keypair, every leaf
+    auto keypair{libsnark::r1cs_ppzksnark_generator<ppT>(fixed.pb.get_constraint_system())};
+    std::string vanilla_dump{hexdump(tree.digest(), Hash::DIGEST_SIZE)};
 
-    out.generate_r1cs_witness(tree.digest());
-    trans.generate_r1cs_witness(data.data());
-    for (size_t i = 0; i < other.size(); ++i)
-        other[i].generate_r1cs_witness(data.data() + (i + 1) * Hash::DIGEST_SIZE);
-    gadget.generate_r1cs_witness();
-
-    bool result;
+    for (size_t trans_idx = 0; trans_idx < Tree::LEAVES_N; ++trans_idx)
     {
-        std::string vanilla{hexdump(tree.digest(), Hash::DIGEST_SIZE)};
-        std::string zkp;
+        std::string zkp_dump = fixed.prove(tree, trans_idx);
 
-        for (auto &&x : out)
-            zkp += hexdump(pb.val(x).as_bigint());
+        result &= zkp_dump == vanilla_dump && zkp_dump == ref.prove(tree, trans_idx);
 
-        //       std::cout << "Vanilla output:\t" << hexdump(tree.digest(), Hash::DIGEST_SIZE) << '\n';
-        //       std::cout << "ZKP output:\t" << zkp << '\n';
+        auto proof{libsnark::r1cs_ppzksnark_prover<ppT>(keypair.pk, fixed.pb.primary_input(),
+                                                        fixed.pb.auxiliary_input())};
 
-        result = vanilla == zkp;
+        result &= libsnark::r1cs_ppzksnark_verifier_strong_IC<ppT>(
+            keypair.vk, fixed.pb.primary_input(), proof);
     }
 
-    auto keypair = libsnark::r1cs_ppzksnark_generator<ppT>(pb.get_constraint_system());
-    auto proof = libsnark::r1cs_ppzksnark_prover<ppT>(keypair.pk, pb.primary_input(),
-                                                      pb.auxiliary_input());
-
-    result &= libsnark::r1cs_ppzksnark_verifier_strong_IC<ppT>(keypair.vk, pb.primary_input(),
-                                                               proof);
-
     return result;
 }
 
@@ -349,93 +134,36 @@ static bool run_tests()
 
     ppT::init_public_params();
 
-    std::cout << "SHA256... ";
+    std::cout << "Arion (2:1)... ";
     std::cout.flush();
     {
-        check = test_mtree<TREE_HEIGHT, GadSha256>();
+        check = test_fixed_mtree<ArionGadget<Arion<FieldT, 2, 1>>>();
     }
     std::cout << check << '\n';
     all_check &= check;
 
-    std::cout << "Path SHA256... ";
+    std::cout << "Griffin (4:1)... ";
     std::cout.flush();
     {
-        check = test_mtree_path<TREE_HEIGHT, GadSha256>();
+        check = test_fixed_mtree<GriffinGadget<Griffin<FieldT, 4, 4>>>();
     }
     std::cout << check << '\n';
     all_check &= check;
 
-    std::cout << "MiMC256... ";
+    std::cout << "Poseidon (8:1)... ";
     std::cout.flush();
     {
-        check = test_pmtree<TREE_HEIGHT, GadMimc256>();
+        check = test_fixed_mtree<PoseidonGadget<Poseidon<FieldT, 8, 1>>>();
     }
     std::cout << check << '\n';
     all_check &= check;
 
-    std::cout << "Path MiMC256... ";
-    std::cout.flush();
-    {
-        check = test_pmtree_path<TREE_HEIGHT, GadMimc256>();
-    }
-    std::cout << check << '\n';
-    all_check &= check;
-
-    std::cout << "Path SHA512... ";
-    std::cout.flush();
-    {
-        check = test_mtree_path<TREE_HEIGHT, GadSha512>();
-    }
-    std::cout << check << '\n';
-    all_check &= check;
-
-    std::cout << "Path MiMC512F... ";
-    std::cout.flush();
-    {
-        check = test_pmtree_path<TREE_HEIGHT, GadMimc512F>();
-    }
-    std::cout << check << '\n';
-    all_check &= check;
-
-    std::cout << "Path MiMC512F2K... ";
-    std::cout.flush();
-    {
-        check = test_pmtree_path<TREE_HEIGHT, GadMimc512F2K>();
-    }
-    std::cout << check << '\n';
-    all_check &= check;
-
-    std::cout << "Path Griffin... ";
-    std::cout.flush();
-    {
-        check = test_pmtree_path<TREE_HEIGHT, GadGriffin>();
-    }
-    std::cout << check << '\n';
-    all_check &= check;
-
-    std::cout << "Path Poseidon... ";
-    std::cout.flush();
-    {
-        check = test_pmtree_path<TREE_HEIGHT, GadPoseidon>();
-    }
-    std::cout << check << '\n';
-    all_check &= check;
-
-    std::cout << "Path Arion... ";
-    std::cout.flush();
-    {
-        check = test_pmtree_path<TREE_HEIGHT, GadArion>();
-    }
-    std::cout << check << '\n';
-    all_check &= check;
-
-
     return all_check;
 }
 
 int main()
 {
-    std::cout << "\n==== Testing MerkleTree Gadget ====\n";
+    std::cout << "\n==== Testing Fixed MerkleTree Gadget ====\n";
 
     bool all_check = run_tests();
 
@@ -443,10 +171,6 @@ int main()
               << " ====\n\n";
 
 #ifdef MEASURE_PERFORMANCE
-    std::cout << "Measuring SHA256 performance:\n";
-    measure([]() { test_mtree<TREE_HEIGHT, GadSha256>(); });
-    std::cout << "Measuring SHA512 performance:\n";
-    measure([]() { test_mtree<TREE_HEIGHT, GadSha512>(); });
 #endif
 
     return 0;
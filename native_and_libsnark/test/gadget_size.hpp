@@ -0,0 +1,42 @@
+#pragma once
+
+#include "gadget/gadget_cost.hpp"
+
+#include <vector>
+
+// The reported cost must match what the hash gadget actually puts on the protoboard
+template<typename GadHash>
+bool test_size()
+{
+    return measure_gadget_cost<GadHash>() ==
+           GadgetCost{GadHash::constraints(), GadHash::variables(), GadHash::nonzero_terms()};
+}
+
+// Same check for a tree gadget of static height
+template<typename GadTree>
+bool test_tree_size()
+{
+    using Field = typename GadTree::Field;
+    using DigVar = typename GadTree::DigVar;
+    using Level = typename GadTree::Level;
+
+    static constexpr size_t DIGEST_VARS = GadTree::DIGEST_VARS;
+
+    libsnark::protoboard<Field> pb;
+    DigVar out{pb, DIGEST_VARS, FMT("out")};
+    DigVar trans{pb, DIGEST_VARS, FMT("trans")};
+    std::vector<Level> other;
+
+    for (size_t i = 0; i < GadTree::HEIGHT - 1; ++i)
+        other.emplace_back(make_uniform_array<Level>(pb, DIGEST_VARS, FMT("other_%llu", i)));
+
+    size_t vars = pb.num_variables();
+
+    GadTree gadget{pb, out, trans, other, FMT("merkle_tree")};
+
+    gadget.generate_r1cs_constraints();
+
+    return pb.num_constraints() == GadTree::constraints() &&
+           pb.num_variables() - vars == GadTree::variables() &&
+           count_nonzero_terms(pb) == GadTree::nonzero_terms();
+}
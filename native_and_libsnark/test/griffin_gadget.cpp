@@ -2,6 +2,7 @@
 #include "hash/griffin/griffin.hpp"
 #include "util/array_utils.hpp"
 #include "util/measure.hpp"
+#include "gadget_size.hpp"
 #include <fstream>
 #include <libff/common/default_types/ec_pp.hpp>
 #include <libsnark/common/default_types/r1cs_ppzksnark_pp.hpp>
@@ -86,6 +87,12 @@ static bool run_tests()
     std::cout << check << '\n';
     all_check &= check;
 
+    std::cout << "Size... ";
+    std::cout.flush();
+    check = test_size<GriffinGadget<Griffin<FieldT, 4, 4>>>();
+    std::cout << check << '\n';
+    all_check &= check;
+
     return all_check;
 }
 
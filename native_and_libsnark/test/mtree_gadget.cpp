@@ -15,6 +15,7 @@
 
 #include "tree/mtree.hpp"
 #include "util/measure.hpp"
+#include "gadget_size.hpp"
 
 #include <libsnark/common/default_types/r1cs_ppzksnark_pp.hpp>
 #include <libsnark/zk_proof_systems/ppzksnark/r1cs_ppzksnark/r1cs_ppzksnark.hpp>
@@ -255,6 +256,36 @@ static bool run_tests()
     std::cout << check << '\n';
     all_check &= check;
 
+    std::cout << "Arion (mux)... ";
+    std::cout.flush();
+    {
+        check = test_mtree<
+            MTreeGadget<TREE_HEIGHT, ArionGadget<Arion<FieldT, 4, 1>>, MTreeSelector::MUX>, true>();
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Path Arion (mux)... ";
+    std::cout.flush();
+    {
+        check = test_mtree<
+            MTreeGadget<TREE_HEIGHT, ArionGadget<Arion<FieldT, 8, 1>>, MTreeSelector::MUX>, false>();
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Size... ";
+    std::cout.flush();
+    {
+        check = test_tree_size<MTreeGadget<TREE_HEIGHT, ArionGadget<Arion<FieldT, 4, 1>>>>() &&
+                test_tree_size<MTreeGadget<TREE_HEIGHT, GriffinGadget<Griffin<FieldT, 2, 1>>>>() &&
+                test_tree_size<MTreeGadget<TREE_HEIGHT, ArionGadget<Arion<FieldT, 4, 1>>,
+                                           MTreeSelector::MUX>>() &&
+                test_tree_size<MTreeGadget<TREE_HEIGHT, Sha256Gadget<FieldT>>>();
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
 
     return all_check;
 }
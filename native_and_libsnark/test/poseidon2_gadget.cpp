@@ -2,6 +2,7 @@
 #include "hash/poseidon2/poseidon2.hpp"
 #include "util/array_utils.hpp"
 #include "util/measure.hpp"
+#include "gadget_size.hpp"
 #include <fstream>
 #include <libff/common/default_types/ec_pp.hpp>
 #include <libsnark/common/default_types/r1cs_ppzksnark_pp.hpp>
@@ -82,6 +83,12 @@ static bool run_tests()
     std::cout << check << '\n';
     all_check &= check;
 
+    std::cout << "Size... ";
+    std::cout.flush();
+    check = test_size<Poseidon2Gadget<Poseidon2<FieldT, 2>>>();
+    std::cout << check << '\n';
+    all_check &= check;
+
 
     return all_check;
 }
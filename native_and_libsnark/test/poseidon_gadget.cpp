@@ -2,6 +2,7 @@
 #include "util/array_utils.hpp"
 #include "hash/poseidon/poseidon.hpp"
 #include "util/measure.hpp"
+#include "gadget_size.hpp"
 #include <fstream>
 #include <libff/common/default_types/ec_pp.hpp>
 #include <libsnark/common/default_types/r1cs_ppzksnark_pp.hpp>
@@ -10,7 +11,7 @@
 using ppT = libsnark::default_r1cs_ppzksnark_pp;
 using FieldT = libff::Fr<ppT>;
 
-bool test()
+bool test(size_t max_terms = 0)
 {
     using GadHash = PoseidonGadget<Poseidon<FieldT, 2, 1>>;
     using DigVar = GadHash::DigVar;
@@ -39,6 +40,7 @@ bool test()
 
     GadHash gadget{pb, in, out, ""};
 
+    gadget.set_max_terms(max_terms);
     out.generate_r1cs_constraints();
     for (auto &&x : in)
         x.generate_r1cs_constraints();
@@ -82,6 +84,18 @@ static bool run_tests()
     std::cout << check << '\n';
     all_check &= check;
 
+    std::cout << "Hashing (bounded LCs)... ";
+    std::cout.flush();
+    check = test(8);
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Size... ";
+    std::cout.flush();
+    check = test_size<PoseidonGadget<Poseidon<FieldT, 2, 1>>>();
+    std::cout << check << '\n';
+    all_check &= check;
+
 
     return all_check;
 }
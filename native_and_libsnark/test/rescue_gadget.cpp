@@ -3,6 +3,7 @@
 #include "util/array_utils.hpp"
 #include "util/measure.hpp"
 #include "util/string_utils.hpp"
+#include "gadget_size.hpp"
 
 #include <libsnark/common/default_types/r1cs_ppzksnark_pp.hpp>
 #include <libsnark/zk_proof_systems/ppzksnark/r1cs_ppzksnark/r1cs_ppzksnark.hpp>
@@ -89,6 +90,12 @@ static bool run_tests()
     std::cout << check << '\n';
     all_check &= check;
 
+    std::cout << "Size... ";
+    std::cout.flush();
+    check = test_size<RescueGadget<Rescue<FieldT, 2, 1>>>();
+    std::cout << check << '\n';
+    all_check &= check;
+
     return all_check;
 }
 